@@ -1,19 +1,26 @@
 #include "Config.h"
-#include "Common.h"
+#include <QCoreApplication>
 #include <QFile>
+#include <QSaveFile>
+#include <QFileSystemWatcher>
+#include <QTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QDebug>
 
 namespace DiscordDrawRPC {
 
-Config::Config() {
-    // Initialize with default values
-    m_config["discord_client_id"] = "";
-    m_config["imgur_client_id"] = "";
-    m_config["enable_tray_icon"] = true;
-    m_config["stop_daemon_on_close"] = false;
-    m_config["auto_start_presence"] = true;
+static constexpr int DEFAULT_MAX_FRAME_SIZE = 64 * 1024;
+static constexpr int DEFAULT_LOG_MAX_SIZE_MB = 10;
+static constexpr int DEFAULT_LOG_MAX_FILES = 5;
+// Folds the events of one save (write, rename, directory change) together
+static constexpr int RELOAD_SETTLE_DELAY_MS = 50;
+
+Config::Config()
+    : m_config(defaults())
+    , m_dirsResolved(false)
+{
+    parseSettings();
 }
 
 Config& Config::instance() {
@@ -21,36 +28,83 @@ Config& Config::instance() {
     return instance;
 }
 
+QJsonObject Config::defaults() {
+    QJsonObject config;
+    config["discord_client_id"] = "";
+    config["imgur_client_id"] = "";
+    config["enable_tray_icon"] = true;
+    config["stop_daemon_on_close"] = false;
+    config["auto_start_presence"] = true;
+    config["max_frame_size"] = DEFAULT_MAX_FRAME_SIZE;
+    config["log_max_size_mb"] = DEFAULT_LOG_MAX_SIZE_MB;
+    config["log_max_files"] = DEFAULT_LOG_MAX_FILES;
+    config["idle_exit_seconds"] = 0;
+    
+    // Lowest level logged per daemon log category
+    QJsonObject logLevels;
+    logLevels["rpc.io"] = "debug";
+    logLevels["rpc.frames"] = "info";
+    logLevels["daemon.state"] = "debug";
+    logLevels["daemon.lifecycle"] = "debug";
+    config["log_levels"] = logLevels;
+    return config;
+}
+
+const PlatformDirs& Config::dirs() const {
+    // Resolving them reads the environment and creates both directories
+    if (!m_dirsResolved) {
+        m_dirs = getPlatformDirs();
+        m_dirsResolved = true;
+    }
+    return m_dirs;
+}
+
+void Config::reloadPlatformDirs() {
+    m_dirsResolved = false;
+    if (m_watcher) {
+        watchPaths();
+    }
+}
+
 QString Config::getConfigFilePath() const {
-    return getPlatformDirs().configDir + "/config.json";
+    return dirs().configDir + "/config.json";
 }
 
 QString Config::getStateFilePath() const {
-    return getPlatformDirs().dataDir + "/state.json";
+    return dirs().dataDir + "/state.json";
 }
 
 QString Config::getDaemonPidFilePath() const {
-    return getPlatformDirs().dataDir + "/daemon.pid";
+    return dirs().dataDir + "/daemon.pid";
 }
 
 QString Config::getGuiPidFilePath() const {
-    return getPlatformDirs().dataDir + "/gui.pid";
+    return dirs().dataDir + "/gui.pid";
 }
 
 QString Config::getTrayPidFilePath() const {
-    return getPlatformDirs().dataDir + "/tray.pid";
+    return dirs().dataDir + "/tray.pid";
 }
 
 QString Config::getCacheFilePath() const {
-    return getPlatformDirs().dataDir + "/image_cache.json";
+    return dirs().dataDir + "/image_cache.json";
 }
 
 QString Config::getCacheImageFilePath() const {
-    return getPlatformDirs().dataDir + "/cached_image.png";
+    return dirs().dataDir + "/cached_image.png";
 }
 
 QString Config::getLogFilePath() const {
-    return getPlatformDirs().dataDir + "/daemon.log";
+    return dirs().dataDir + "/daemon.log";
+}
+
+QString Config::getControlSocketPath() const {
+#ifdef _WIN32
+    // Windows: QLocalServer maps plain names onto \\.\pipe\<name>
+    return "discord-drawing-rpc-" + qEnvironmentVariable("USERNAME");
+#else
+    return dirs().dataDir + "/daemon.sock";
+#endif
 }
 
 bool Config::load() {
@@ -60,48 +114,142 @@ bool Config::load() {
     if (!file.open(QIODevice::ReadOnly)) {
         // Config file doesn't exist, create it with defaults
         qDebug() << "Config file not found, creating with defaults";
+        m_config = defaults();
+        parseSettings();
         return save();
     }
     
-    QByteArray data = file.readAll();
-    file.close();
-    
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (doc.isNull() || !doc.isObject()) {
+    if (!apply(file.readAll())) {
         qWarning() << "Invalid config file format";
         return false;
     }
-    
-    m_config = doc.object();
     return true;
 }
 
 bool Config::save() {
     QString configPath = getConfigFilePath();
     
-    QFile file(configPath);
+    // Replaced atomically so a watching process never reads half a file
+    QSaveFile file(configPath);
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "Failed to open config file for writing:" << configPath;
         return false;
     }
     
-    QJsonDocument doc(m_config);
-    file.write(doc.toJson(QJsonDocument::Indented));
-    file.close();
+    QByteArray data = QJsonDocument(m_config).toJson(QJsonDocument::Indented);
+    file.write(data);
+    if (!file.commit()) {
+        qWarning() << "Failed to write config file:" << configPath;
+        return false;
+    }
+    
+    m_fileContents = data;
+    return true;
+}
+
+bool Config::apply(const QByteArray& data) {
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject()) {
+        return false;
+    }
+    
+    QJsonObject config = defaults();
+    const QJsonObject file = doc.object();
+    for (auto it = file.constBegin(); it != file.constEnd(); ++it) {
+        config[it.key()] = it.value();
+    }
     
+    m_config = config;
+    m_fileContents = data;
+    parseSettings();
     return true;
 }
 
+void Config::parseSettings() {
+    m_discordClientId = m_config.value("discord_client_id").toString();
+    m_imgurClientId = m_config.value("imgur_client_id").toString();
+    m_enableTrayIcon = m_config.value("enable_tray_icon").toBool(true);
+    m_stopDaemonOnClose = m_config.value("stop_daemon_on_close").toBool(false);
+    m_autoStartPresence = m_config.value("auto_start_presence").toBool(true);
+    m_maxFrameSize = m_config.value("max_frame_size").toInt(DEFAULT_MAX_FRAME_SIZE);
+    m_logMaxSizeMb = m_config.value("log_max_size_mb").toInt(DEFAULT_LOG_MAX_SIZE_MB);
+    m_logMaxFiles = m_config.value("log_max_files").toInt(DEFAULT_LOG_MAX_FILES);
+    m_idleExitSeconds = m_config.value("idle_exit_seconds").toInt(0);
+    m_logLevels = m_config.value("log_levels").toObject();
+}
+
+void Config::watchForChanges() {
+    if (m_watcher) {
+        return;
+    }
+    
+    m_reloadTimer = new QTimer(QCoreApplication::instance());
+    m_reloadTimer->setSingleShot(true);
+    connect(m_reloadTimer, &QTimer::timeout, this, &Config::reloadIfChanged);
+    
+    // The directory sees the file being replaced, the file sees in-place writes
+    m_watcher = new QFileSystemWatcher(QCoreApplication::instance());
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &Config::onFileEvent);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &Config::onFileEvent);
+    watchPaths();
+}
+
+void Config::watchPaths() {
+    const QStringList watched = m_watcher->files() + m_watcher->directories();
+    if (!watched.isEmpty()) {
+        m_watcher->removePaths(watched);
+    }
+    
+    m_watcher->addPath(dirs().configDir);
+    if (QFile::exists(getConfigFilePath())) {
+        m_watcher->addPath(getConfigFilePath());
+    }
+}
+
+void Config::onFileEvent() {
+    // The watch on a file is lost when it gets replaced
+    QString configPath = getConfigFilePath();
+    if (!m_watcher->files().contains(configPath) && QFile::exists(configPath)) {
+        m_watcher->addPath(configPath);
+    }
+    
+    if (!m_reloadTimer->isActive()) {
+        m_reloadTimer->start(RELOAD_SETTLE_DELAY_MS);
+    }
+}
+
+void Config::reloadIfChanged() {
+    QFile file(getConfigFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    
+    QByteArray data = file.readAll();
+    if (data == m_fileContents) {
+        return;
+    }
+    
+    if (!apply(data)) {
+        qWarning() << "Ignoring invalid change to" << file.fileName();
+        return;
+    }
+    
+    qDebug() << "Configuration reloaded from" << file.fileName();
+    emit changed();
+}
+
 QString Config::getValue(const QString& key) const {
     return m_config.value(key).toString();
 }
 
 void Config::setValue(const QString& key, const QString& value) {
     m_config[key] = value;
+    parseSettings();
 }
 
 void Config::setConfig(const QJsonObject& config) {
     m_config = config;
+    parseSettings();
 }
 
 } // namespace DiscordDrawRPC
@@ -1,11 +1,27 @@
 #pragma once
 
+#include <QObject>
+#include <QPointer>
 #include <QString>
+#include <QByteArray>
 #include <QJsonObject>
+#include "Common.h"
+
+class QFileSystemWatcher;
+class QTimer;
 
 namespace DiscordDrawRPC {
 
-class Config {
+/**
+ * Settings shared by the GUI, tray and daemon, kept in config.json.
+ * The platform directories are resolved once and the known settings are
+ * parsed into typed fields whenever the file is read, so reading them
+ * involves no JSON. After watchForChanges() the file is reloaded when
+ * another process or an editor changes it, and changed() is emitted.
+ */
+class Config : public QObject {
+    Q_OBJECT
+    
 public:
     static Config& instance();
     
@@ -15,6 +31,13 @@ public:
     // Save configuration to file
     bool save();
     
+    // Reload the file whenever it changes on disk, needs a running event loop
+    void watchForChanges();
+    
+    // Resolve the platform directories again, for tools that switch between
+    // profiles by changing the environment
+    void reloadPlatformDirs();
+    
     // Get a configuration value
     QString getValue(const QString& key) const;
     
@@ -22,11 +45,24 @@ public:
     void setValue(const QString& key, const QString& value);
     
     // Get the full config object
-    QJsonObject getConfig() const { return m_config; }
+    const QJsonObject& getConfig() const { return m_config; }
     
     // Set the full config object
     void setConfig(const QJsonObject& config);
     
+    // Typed settings, defaults filled in for keys the file lacks
+    const QString& discordClientId() const { return m_discordClientId; }
+    const QString& imgurClientId() const { return m_imgurClientId; }
+    bool enableTrayIcon() const { return m_enableTrayIcon; }
+    bool stopDaemonOnClose() const { return m_stopDaemonOnClose; }
+    bool autoStartPresence() const { return m_autoStartPresence; }
+    int maxFrameSize() const { return m_maxFrameSize; }
+    int logMaxSizeMb() const { return m_logMaxSizeMb; }
+    int logMaxFiles() const { return m_logMaxFiles; }
+    // A socket activated daemon exits after this long without a presence, 0 never
+    int idleExitSeconds() const { return m_idleExitSeconds; }
+    const QJsonObject& logLevels() const { return m_logLevels; }
+    
     // Config file paths
     QString getConfigFilePath() const;
     QString getStateFilePath() const;
@@ -36,10 +72,45 @@ public:
     QString getCacheFilePath() const;
     QString getCacheImageFilePath() const;
     QString getLogFilePath() const;
+    QString getControlSocketPath() const;
+    
+signals:
+    // The file changed on disk and has been reloaded
+    void changed();
     
 private:
     Config();
+    
+    static QJsonObject defaults();
+    const PlatformDirs& dirs() const;
+    // Defaults overlaid with the file's contents
+    bool apply(const QByteArray& data);
+    void parseSettings();
+    void watchPaths();
+    void onFileEvent();
+    void reloadIfChanged();
+    
     QJsonObject m_config;
+    // The file as last read or written, so our own saves aren't reloaded
+    QByteArray m_fileContents;
+    
+    mutable PlatformDirs m_dirs;
+    mutable bool m_dirsResolved;
+    
+    QString m_discordClientId;
+    QString m_imgurClientId;
+    bool m_enableTrayIcon;
+    bool m_stopDaemonOnClose;
+    bool m_autoStartPresence;
+    int m_maxFrameSize;
+    int m_logMaxSizeMb;
+    int m_logMaxFiles;
+    int m_idleExitSeconds;
+    QJsonObject m_logLevels;
+    
+    // Owned by the application, so they go before this static instance does
+    QPointer<QFileSystemWatcher> m_watcher;
+    QPointer<QTimer> m_reloadTimer;
 };
 
 } // namespace DiscordDrawRPC
@@ -2,13 +2,137 @@
 #include "Config.h"
 
 #include <QFile>
+#include <QSaveFile>
 #include <QJsonDocument>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QtEndian>
 #include <QDebug>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace DiscordDrawRPC {
 
+// How long a UI component waits for the daemon to acknowledge a request
+static constexpr int CONNECT_TIMEOUT_MS = 500;
+static constexpr int REQUEST_TIMEOUT_MS = 2000;
+
+// Only has to tell the answer apart on its own connection
+static int nextRequestId() {
+    static int nextId = 1;
+    return nextId++;
+}
+
+// Held by a writer from reading the last "seq" until its snapshot replaced
+// the file, so the GUI and the daemon never hand out the same number. A
+// separate file is locked, the state file itself is replaced by every
+// write. Like the PID file locks it goes away with the process that held it.
+namespace {
+class StateFileLock {
+public:
+    explicit StateFileLock(const QString& stateFile) {
+        QString path = stateFile + ".lock";
+#ifdef _WIN32
+        m_file = CreateFileW(reinterpret_cast<const wchar_t*>(path.utf16()),
+                             GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        OVERLAPPED region = {};
+        if (m_file == INVALID_HANDLE_VALUE || !LockFileEx(m_file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &region)) {
+            qWarning() << "Failed to lock" << path << ", writing the state file unlocked";
+        }
+#else
+        m_fd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (m_fd < 0 || flock(m_fd, LOCK_EX) != 0) {
+            qWarning() << "Failed to lock" << path << ", writing the state file unlocked";
+        }
+#endif
+    }
+    
+    ~StateFileLock() {
+        // Closing the handle drops the lock
+#ifdef _WIN32
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+        }
+#else
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+#endif
+    }
+    
+private:
+#ifdef _WIN32
+    HANDLE m_file;
+#else
+    int m_fd;
+#endif
+};
+} // namespace
+
+namespace DaemonProtocol {
+
+QByteArray encode(const QJsonObject& message) {
+    QByteArray payload = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    
+    QByteArray frame;
+    frame.reserve(4 + payload.size());
+    
+    char header[4];
+    qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), header);
+    frame.append(header, 4);
+    frame.append(payload);
+    
+    return frame;
+}
+
+DecodeResult decode(QByteArray& buffer, QJsonObject& message) {
+    if (buffer.size() < 4) {
+        return DecodeResult::Incomplete;
+    }
+    
+    quint32 length = qFromLittleEndian<quint32>(buffer.constData());
+    if (length > MAX_MESSAGE_SIZE) {
+        return DecodeResult::Invalid;
+    }
+    
+    if (static_cast<quint32>(buffer.size()) - 4 < length) {
+        return DecodeResult::Incomplete;
+    }
+    
+    QJsonDocument doc = QJsonDocument::fromJson(buffer.mid(4, length));
+    buffer.remove(0, 4 + length);
+    
+    if (doc.isNull() || !doc.isObject()) {
+        return DecodeResult::Invalid;
+    }
+    
+    message = doc.object();
+    return DecodeResult::Message;
+}
+
+} // namespace DaemonProtocol
+
 bool DaemonIPC::sendQuitCommand() {
-    return setCommand("quit");
+    return sendRequest("quit", QJsonObject());
+}
+
+void DaemonIPC::sendQuitCommand(QObject* context, Callback done) {
+    sendRequest("quit", QJsonObject(), context, [done](bool ok, const QJsonObject&) {
+        if (done) {
+            done(ok);
+        }
+    });
 }
 
 bool DaemonIPC::setUpdateCommand() {
@@ -17,12 +141,12 @@ bool DaemonIPC::setUpdateCommand() {
 
 bool DaemonIPC::setCommand(const QString& command) {
     // Read existing state to preserve fields
-    QJsonObject stateData = readStateFile();
+    QJsonObject stateData = readStateSnapshot();
     
     // Set command
     stateData["command"] = command;
     
-    return writeStateFile(stateData);
+    return writeStateSnapshot(stateData);
 }
 
 bool DaemonIPC::sendUpdateCommand(
@@ -31,6 +155,51 @@ bool DaemonIPC::sendUpdateCommand(
     const QString& details,
     const QString& state,
     qint64 startTimestamp)
+{
+    QJsonObject stateData = updateState(largeImage, largeText, details, state, startTimestamp);
+    
+    QJsonObject payload;
+    payload["state"] = stateData;
+    
+    if (sendRequest("update", payload)) {
+        return true;
+    }
+    
+    // Daemon not reachable, keep the status for when it starts
+    return writeStateSnapshot(stateData);
+}
+
+void DaemonIPC::sendUpdateCommand(
+    const QString& largeImage,
+    const QString& largeText,
+    const QString& details,
+    const QString& state,
+    qint64 startTimestamp,
+    QObject* context,
+    Callback done)
+{
+    QJsonObject stateData = updateState(largeImage, largeText, details, state, startTimestamp);
+    
+    QJsonObject payload;
+    payload["state"] = stateData;
+    
+    sendRequest("update", payload, context, [stateData, done](bool ok, const QJsonObject&) {
+        // Daemon not reachable, keep the status for when it starts
+        if (!ok) {
+            ok = writeStateSnapshot(stateData);
+        }
+        if (done) {
+            done(ok);
+        }
+    });
+}
+
+QJsonObject DaemonIPC::updateState(
+    const QString& largeImage,
+    const QString& largeText,
+    const QString& details,
+    const QString& state,
+    qint64 startTimestamp)
 {
     QJsonObject stateData;
     stateData["command"] = "update";
@@ -39,15 +208,159 @@ bool DaemonIPC::sendUpdateCommand(
     stateData["details"] = details;
     stateData["state"] = state;
     stateData["start"] = startTimestamp;
-    
-    return writeStateFile(stateData);
+    return stateData;
+}
+
+bool DaemonIPC::sendClearCommand() {
+    return sendRequest("clear", QJsonObject());
+}
+
+void DaemonIPC::sendClearCommand(QObject* context, Callback done) {
+    sendRequest("clear", QJsonObject(), context, [done](bool ok, const QJsonObject&) {
+        if (done) {
+            done(ok);
+        }
+    });
 }
 
 QJsonObject DaemonIPC::readCurrentState() {
-    return readStateFile();
+    QJsonObject response;
+    if (sendRequest("get_state", QJsonObject(), &response)) {
+        return response.value("state").toObject();
+    }
+    
+    return readStateSnapshot();
+}
+
+void DaemonIPC::readCurrentState(QObject* context, std::function<void(const QJsonObject& state)> done) {
+    sendRequest("get_state", QJsonObject(), context, [done](bool ok, const QJsonObject& response) {
+        done(ok ? response.value("state").toObject() : readStateSnapshot());
+    });
+}
+
+bool DaemonIPC::sendRequest(const QString& op, const QJsonObject& payload, QJsonObject* response) {
+    QLocalSocket socket;
+    socket.connectToServer(Config::instance().getControlSocketPath());
+    if (!socket.waitForConnected(CONNECT_TIMEOUT_MS)) {
+        return false;
+    }
+    
+    QJsonObject request = payload;
+    int requestId = nextRequestId();
+    request["id"] = requestId;
+    request["op"] = op;
+    
+    socket.write(DaemonProtocol::encode(request));
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    QByteArray buffer;
+    while (timer.elapsed() < REQUEST_TIMEOUT_MS) {
+        if (!socket.waitForReadyRead(REQUEST_TIMEOUT_MS - static_cast<int>(timer.elapsed()))) {
+            break;
+        }
+        buffer.append(socket.readAll());
+        
+        QJsonObject message;
+        DaemonProtocol::DecodeResult result;
+        while ((result = DaemonProtocol::decode(buffer, message)) == DaemonProtocol::DecodeResult::Message) {
+            if (message.value("id").toInt() != requestId) {
+                continue;
+            }
+            
+            if (response) {
+                *response = message;
+            }
+            
+            bool ok = message.value("ok").toBool();
+            if (!ok) {
+                qWarning() << "Daemon rejected" << op << "request:" << message.value("error").toString();
+            }
+            return ok;
+        }
+        
+        if (result == DaemonProtocol::DecodeResult::Invalid) {
+            qWarning() << "Invalid response from daemon control socket";
+            return false;
+        }
+    }
+    
+    qWarning() << "Timed out waiting for daemon to acknowledge" << op;
+    return false;
+}
+
+void DaemonIPC::sendRequest(const QString& op, const QJsonObject& payload, QObject* context,
+                            std::function<void(bool ok, const QJsonObject& response)> done) {
+    // Not owned by the context: done may destroy it, and the socket has to
+    // get through the handler that called done first
+    QLocalSocket* socket = new QLocalSocket();
+    QTimer* timer = new QTimer(socket);
+    timer->setSingleShot(true);
+    auto buffer = std::make_shared<QByteArray>();
+    int requestId = nextRequestId();
+    QPointer<QObject> guard(context);
+    
+    // Runs once, the socket's signals are cut before anything else
+    auto finish = [socket, timer, guard, done](bool ok, const QJsonObject& response) {
+        timer->stop();
+        socket->disconnect();
+        socket->abort();
+        socket->deleteLater();
+        if (guard) {
+            QMetaObject::invokeMethod(guard.data(), [done, ok, response]() {
+                done(ok, response);
+            }, Qt::QueuedConnection);
+        }
+    };
+    
+    QObject::connect(timer, &QTimer::timeout, socket, [finish, op]() {
+        qWarning() << "Timed out waiting for daemon to acknowledge" << op;
+        finish(false, QJsonObject());
+    });
+    QObject::connect(socket, &QLocalSocket::connected, socket, [socket, timer, op, payload, requestId]() {
+        QJsonObject request = payload;
+        request["id"] = requestId;
+        request["op"] = op;
+        socket->write(DaemonProtocol::encode(request));
+        timer->start(REQUEST_TIMEOUT_MS);
+    });
+    QObject::connect(socket, &QLocalSocket::readyRead, socket, [socket, buffer, finish, op, requestId]() {
+        buffer->append(socket->readAll());
+        
+        QJsonObject message;
+        DaemonProtocol::DecodeResult result;
+        while ((result = DaemonProtocol::decode(*buffer, message)) == DaemonProtocol::DecodeResult::Message) {
+            if (message.value("id").toInt() != requestId) {
+                continue;
+            }
+            
+            bool ok = message.value("ok").toBool();
+            if (!ok) {
+                qWarning() << "Daemon rejected" << op << "request:" << message.value("error").toString();
+            }
+            finish(ok, message);
+            return;
+        }
+        
+        if (result == DaemonProtocol::DecodeResult::Invalid) {
+            qWarning() << "Invalid response from daemon control socket";
+            finish(false, QJsonObject());
+        }
+    });
+    // Not listening, refused, or closed before answering
+    QObject::connect(socket, &QLocalSocket::errorOccurred, socket, [finish]() {
+        finish(false, QJsonObject());
+    });
+    
+    // Connecting can fail right away, deferred so done never runs before we return
+    timer->start(CONNECT_TIMEOUT_MS);
+    QTimer::singleShot(0, socket, [socket]() {
+        socket->connectToServer(Config::instance().getControlSocketPath());
+    });
 }
 
-QJsonObject DaemonIPC::readStateFile() {
+QJsonObject DaemonIPC::readStateSnapshot() {
     QString stateFile = Config::instance().getStateFilePath();
     
     QFile file(stateFile);
@@ -66,20 +379,35 @@ QJsonObject DaemonIPC::readStateFile() {
     return doc.object();
 }
 
-bool DaemonIPC::writeStateFile(const QJsonObject& data) {
+bool DaemonIPC::writeStateSnapshot(const QJsonObject& data, qint64* seq) {
     QString stateFile = Config::instance().getStateFilePath();
+    StateFileLock lock(stateFile);
     
-    QFile file(stateFile);
+    // Every write advances the sequence so readers can tell new snapshots
+    // from repeated change notifications
+    qint64 nextSeq = qMax(readStateSnapshot().value("seq").toInteger(),
+                          data.value("seq").toInteger()) + 1;
+    QJsonObject stored = data;
+    stored["seq"] = nextSeq;
+    
+    // Written to a temporary file and renamed over the old one, so readers
+    // never see a half-written snapshot
+    QSaveFile file(stateFile);
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "Failed to open state file for writing:" << stateFile;
         return false;
     }
     
-    QJsonDocument doc(data);
-    qint64 bytesWritten = file.write(doc.toJson());
-    file.close();
+    file.write(QJsonDocument(stored).toJson());
+    if (!file.commit()) {
+        qWarning() << "Failed to write state file:" << stateFile;
+        return false;
+    }
     
-    return bytesWritten > 0;
+    if (seq) {
+        *seq = nextSeq;
+    }
+    return true;
 }
 
 } // namespace DiscordDrawRPC
@@ -2,23 +2,81 @@
 #define DAEMONIPC_H
 
 #include <QString>
+#include <QByteArray>
 #include <QJsonObject>
+#include <functional>
+
+class QObject;
 
 namespace DiscordDrawRPC {
 
+/**
+ * @brief Wire format of the daemon control socket
+ * 
+ * Every message is a compact JSON object prefixed by its length:
+ * [length: uint32 little-endian][payload: json bytes]
+ * 
+ * Requests carry an "id" and an "op" ("update", "clear", "quit", "get_state",
+ * "stats", "metrics" or "subscribe"). The daemon answers each request with a
+ * message echoing the same "id" and an "ok" flag, plus "state", "stats",
+ * "metrics" (Prometheus text format), "status" or "error" depending on the
+ * request and its outcome.
+ * 
+ * After a "subscribe" the connection stays open and the daemon pushes
+ * messages without an "id", holding an "event" ("started",
+ * "discord_connected", "discord_disconnected", "presence_applied" or
+ * "stopping") and the resulting "status".
+ */
+namespace DaemonProtocol {
+
+constexpr quint32 MAX_MESSAGE_SIZE = 1024 * 1024;
+
+enum class DecodeResult {
+    Incomplete,
+    Message,
+    Invalid
+};
+
+/**
+ * @brief Encode a JSON object into a length-prefixed message
+ */
+QByteArray encode(const QJsonObject& message);
+
+/**
+ * @brief Take the next complete message from the front of a receive buffer
+ * @param buffer Bytes received so far; consumed bytes are removed
+ * @param message Receives the decoded object when Message is returned
+ * @return Incomplete if more data is needed, Invalid if the stream is corrupt
+ */
+DecodeResult decode(QByteArray& buffer, QJsonObject& message);
+
+} // namespace DaemonProtocol
+
 /**
  * @brief Inter-Process Communication interface for daemon control
  * 
  * Provides a centralized interface for all UI components to communicate
- * with the Discord RPC daemon via the state file.
+ * with the Discord RPC daemon. Commands are sent over the daemon's control
+ * socket and acknowledged by the daemon; the state file is only kept as a
+ * persisted snapshot that the daemon applies when it starts.
+ * 
+ * Every command comes in two forms. The plain one waits for the daemon's
+ * answer, which can take seconds when the daemon is busy or hung, and is
+ * meant for tools without an event loop to keep going. The one taking a
+ * context returns right away and calls back on the context's thread once
+ * the daemon answered or the request failed; the callback is dropped if
+ * the context is destroyed first. UI components use that one.
  */
 class DaemonIPC {
 public:
+    using Callback = std::function<void(bool ok)>;
+    
     /**
      * @brief Send a quit command to the daemon
-     * @return true if command was written successfully, false otherwise
+     * @return true if the daemon acknowledged the command, false otherwise
      */
     static bool sendQuitCommand();
+    static void sendQuitCommand(QObject* context, Callback done = Callback());
     
     /**
      * @brief Set the command field to "update" while preserving all other state data
@@ -29,12 +87,16 @@ public:
     
     /**
      * @brief Send an update command to the daemon with new Discord status
+     * 
+     * If the daemon is not reachable the status is written to the state
+     * snapshot instead, so it is applied as soon as the daemon starts.
+     * 
      * @param largeImage URL of the image to display
      * @param largeText Tooltip text for the large image
      * @param details Main status text (first line)
      * @param state Secondary status text (second line)
      * @param startTimestamp Unix timestamp for elapsed time (0 to disable)
-     * @return true if command was written successfully, false otherwise
+     * @return true if the daemon acknowledged the update or the snapshot was written
      */
     static bool sendUpdateCommand(
         const QString& largeImage,
@@ -43,26 +105,79 @@ public:
         const QString& state,
         qint64 startTimestamp
     );
+    static void sendUpdateCommand(
+        const QString& largeImage,
+        const QString& largeText,
+        const QString& details,
+        const QString& state,
+        qint64 startTimestamp,
+        QObject* context,
+        Callback done = Callback()
+    );
+    
+    /**
+     * @brief Ask the daemon to clear the Discord presence
+     * @return true if the daemon acknowledged the command, false otherwise
+     */
+    static bool sendClearCommand();
+    static void sendClearCommand(QObject* context, Callback done = Callback());
     
     /**
-     * @brief Read the current state from the daemon state file
+     * @brief Read the current state from the daemon, or from the snapshot if it isn't running
      * @return QJsonObject containing current state, or empty object if failed
      */
     static QJsonObject readCurrentState();
+    static void readCurrentState(QObject* context, std::function<void(const QJsonObject& state)> done);
     
-private:
     /**
-     * @brief Read existing state file and return as JSON object
+     * @brief Read the persisted state snapshot
      * @return Current state data, or empty object if file doesn't exist/is invalid
      */
-    static QJsonObject readStateFile();
+    static QJsonObject readStateSnapshot();
     
     /**
-     * @brief Write JSON data to the state file
+     * @brief Persist a state snapshot
+     * 
+     * The file is replaced atomically and gets a "seq" field one higher than
+     * the snapshot it replaces. Writers in other processes are locked out
+     * meanwhile, so no two snapshots get the same "seq".
+     * 
      * @param data JSON object to write
+     * @param seq Receives the sequence number that was written
      * @return true if write was successful, false otherwise
      */
-    static bool writeStateFile(const QJsonObject& data);
+    static bool writeStateSnapshot(const QJsonObject& data, qint64* seq = nullptr);
+    
+private:
+    /**
+     * @brief Send a request over the control socket and wait for its acknowledgement
+     * @param op Operation name
+     * @param payload Extra request fields
+     * @param response Receives the daemon's response
+     * @return true if the daemon answered with ok=true, false otherwise
+     */
+    static bool sendRequest(const QString& op, const QJsonObject& payload, QJsonObject* response = nullptr);
+    
+    /**
+     * @brief Send a request over the control socket without waiting for it
+     * @param op Operation name
+     * @param payload Extra request fields
+     * @param context Object whose thread runs done, done is dropped once it is destroyed
+     * @param done Called with the outcome and the daemon's response, never before this returns
+     */
+    static void sendRequest(const QString& op, const QJsonObject& payload, QObject* context,
+                            std::function<void(bool ok, const QJsonObject& response)> done);
+    
+    /**
+     * @brief The state an "update" request carries and the snapshot keeps
+     */
+    static QJsonObject updateState(
+        const QString& largeImage,
+        const QString& largeText,
+        const QString& details,
+        const QString& state,
+        qint64 startTimestamp
+    );
     
     /**
      * @brief Helper to change only the command field while preserving other data
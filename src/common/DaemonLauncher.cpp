@@ -0,0 +1,260 @@
+#include "DaemonLauncher.h"
+#include "Config.h"
+#include "DaemonIPC.h"
+#include "NotifySocket.h"
+#include "ProcessWatcher.h"
+#include <QCoreApplication>
+#include <QJsonObject>
+#include <QDir>
+#include <QFile>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QDebug>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <QSocketNotifier>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace DiscordDrawRPC {
+
+// Control socket fallback
+static constexpr int PROBE_INTERVAL_MS = 100;
+
+DaemonLauncher::DaemonLauncher(QObject* parent)
+    : QObject(parent)
+    , m_timeoutTimer(new QTimer(this))
+    , m_watcher(nullptr)
+    , m_finished(false)
+    , m_notifyFd(-1)
+    , m_notifier(nullptr)
+    , m_probe(nullptr)
+    , m_probeTimer(nullptr)
+    , m_request(nullptr)
+{
+    m_timeoutTimer->setSingleShot(true);
+    m_timeoutTimer->setInterval(DEFAULT_TIMEOUT_MS);
+    connect(m_timeoutTimer, &QTimer::timeout, this, [this]() {
+        finish(QString("The daemon did not get ready within %1 seconds").arg(m_timeoutTimer->interval() / 1000.0));
+    });
+}
+
+DaemonLauncher::~DaemonLauncher() {
+    closeNotifySocket();
+}
+
+bool DaemonLauncher::start(const QString& program, const QStringList& arguments) {
+    if (requestFromListener()) {
+        m_timeoutTimer->start();
+        return true;
+    }
+    
+    QProcess process;
+    process.setProgram(program);
+    process.setArguments(arguments);
+
+#ifdef _WIN32
+    process.setCreateProcessArgumentsModifier([](QProcess::CreateProcessArguments* args) {
+        args->flags |= CREATE_NO_WINDOW;
+    });
+#endif
+
+    if (openNotifySocket()) {
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert(NOTIFY_SOCKET_ENV, QFile::decodeName(m_notifyPath));
+        process.setProcessEnvironment(environment);
+    }
+    
+    qint64 pid = 0;
+    if (!process.startDetached(&pid)) {
+        qWarning() << "Failed to start" << program << process.errorString();
+        closeNotifySocket();
+        return false;
+    }
+    
+    // Readiness that arrives before the exit is noticed still counts
+    m_watcher = new ProcessWatcher(pid, this);
+    connect(m_watcher, &ProcessWatcher::exited, this, &DaemonLauncher::onExited);
+    m_timeoutTimer->start();
+    
+    if (m_notifyFd < 0) {
+        probeControlSocket();
+    }
+    return true;
+}
+
+bool DaemonLauncher::requestFromListener() {
+    // Connecting to a local socket succeeds or fails right away, unless the
+    // listener's backlog is full
+    m_request = new QLocalSocket(this);
+    m_request->connectToServer(Config::instance().getControlSocketPath());
+    if (m_request->state() == QLocalSocket::UnconnectedState) {
+        delete m_request;
+        m_request = nullptr;
+        return false;
+    }
+    
+    qDebug() << "Control socket is listening, waiting for the daemon behind it";
+    connect(m_request, &QLocalSocket::readyRead, this, &DaemonLauncher::readListenerResponse);
+    connect(m_request, &QLocalSocket::errorOccurred, this, [this]() {
+        finish("The daemon exited before it was ready, see its log for details");
+    });
+    
+    auto sendRequest = [this]() {
+        QJsonObject request;
+        request["id"] = 1;
+        request["op"] = "get_state";
+        m_request->write(DaemonProtocol::encode(request));
+    };
+    if (m_request->state() == QLocalSocket::ConnectedState) {
+        sendRequest();
+    } else {
+        connect(m_request, &QLocalSocket::connected, this, sendRequest);
+    }
+    return true;
+}
+
+void DaemonLauncher::readListenerResponse() {
+    m_response.append(m_request->readAll());
+    
+    QJsonObject message;
+    DaemonProtocol::DecodeResult result = DaemonProtocol::decode(m_response, message);
+    if (result == DaemonProtocol::DecodeResult::Message) {
+        finish(QString());
+    } else if (result == DaemonProtocol::DecodeResult::Invalid) {
+        finish("Invalid response from the daemon control socket");
+    }
+}
+
+bool DaemonLauncher::openNotifySocket() {
+#ifdef _WIN32
+    return false;
+#else
+    static int launches = 0;
+    QString name = QString("discord-draw-rpc-launch-%1-%2").arg(QCoreApplication::applicationPid()).arg(++launches);
+
+#ifdef __linux__
+    // Abstract names go away with the socket, nothing is left behind
+    QByteArray path = '@' + name.toUtf8();
+#else
+    QByteArray path = QFile::encodeName(QDir::temp().filePath(name));
+#endif
+
+    sockaddr_un address;
+    socklen_t length = notifySocketAddress(path, address);
+    if (length == 0) {
+        return false;
+    }
+    
+    int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    
+    // Not inherited by the daemon, and never blocks the event loop
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), length) < 0) {
+        qWarning() << "Failed to bind launch notify socket:" << std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    
+    m_notifyFd = fd;
+    m_notifyPath = path;
+    m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &DaemonLauncher::readNotifications);
+    return true;
+#endif
+}
+
+void DaemonLauncher::closeNotifySocket() {
+#ifndef _WIN32
+    // May be called from the notifier's own signal
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = nullptr;
+    }
+    
+    if (m_notifyFd >= 0) {
+        ::close(m_notifyFd);
+        m_notifyFd = -1;
+        if (!m_notifyPath.startsWith('@')) {
+            ::unlink(m_notifyPath.constData());
+        }
+    }
+#endif
+}
+
+void DaemonLauncher::readNotifications() {
+#ifndef _WIN32
+    // One datagram per notification, possibly several newline separated
+    // assignments each
+    char buffer[4096];
+    ssize_t size;
+    while (m_notifyFd >= 0 && (size = ::recv(m_notifyFd, buffer, sizeof(buffer), 0)) > 0) {
+        const QList<QByteArray> assignments = QByteArray(buffer, size).split('\n');
+        if (assignments.contains(NOTIFY_READY)) {
+            finish(QString());
+            return;
+        }
+    }
+#endif
+}
+
+void DaemonLauncher::probeControlSocket() {
+    if (!m_probe) {
+        m_probe = new QLocalSocket(this);
+        m_probeTimer = new QTimer(this);
+        m_probeTimer->setSingleShot(true);
+        m_probeTimer->setInterval(PROBE_INTERVAL_MS);
+        connect(m_probeTimer, &QTimer::timeout, this, &DaemonLauncher::probeControlSocket);
+        connect(m_probe, &QLocalSocket::connected, this, [this]() { finish(QString()); });
+        connect(m_probe, &QLocalSocket::errorOccurred, m_probeTimer, qOverload<>(&QTimer::start));
+    }
+    
+    m_probe->abort();
+    m_probe->connectToServer(Config::instance().getControlSocketPath());
+}
+
+void DaemonLauncher::onExited() {
+    readNotifications();
+    finish("The daemon exited before it was ready, see its log for details");
+}
+
+void DaemonLauncher::finish(const QString& error) {
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    
+    m_timeoutTimer->stop();
+    if (m_probeTimer) {
+        m_probeTimer->stop();
+    }
+    if (m_probe) {
+        m_probe->abort();
+    }
+    if (m_request) {
+        // May be called from the socket's own signal
+        m_request->disconnect(this);
+        m_request->abort();
+    }
+    closeNotifySocket();
+    
+    if (error.isEmpty()) {
+        emit ready();
+    } else {
+        emit failed(error);
+    }
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+class QLocalSocket;
+class QSocketNotifier;
+
+namespace DiscordDrawRPC {
+
+class ProcessWatcher;
+
+/**
+ * Starts the daemon detached and reports, without blocking, once it is
+ * ready to take requests. The daemon is handed a datagram socket through
+ * NOTIFY_SOCKET, as systemd does for sd_notify(), and sends "READY=1" on it
+ * once its control socket listens and the initial state is applied. Where
+ * no such socket can be made (Windows) the launcher waits for the control
+ * socket to accept a connection instead.
+ * 
+ * When something already accepts connections on the control socket, such
+ * as a socket activator (systemd or tools/socket-activator) holding it for
+ * a daemon that isn't running, nothing is spawned: a request is sent there,
+ * which starts the daemon, and its answer means the daemon is ready.
+ * 
+ * Exactly one of ready() and failed() follows a successful start(): failed()
+ * when the daemon exits first or doesn't get ready within the timeout.
+ */
+class DaemonLauncher : public QObject {
+    Q_OBJECT
+    
+public:
+    static constexpr int DEFAULT_TIMEOUT_MS = 5000;
+    
+    explicit DaemonLauncher(QObject* parent = nullptr);
+    ~DaemonLauncher();
+    
+    void setTimeout(int timeoutMs) { m_timeoutTimer->setInterval(timeoutMs); }
+    
+    // Returns false if the process couldn't be started at all
+    bool start(const QString& program, const QStringList& arguments = QStringList());
+    
+signals:
+    void ready();
+    void failed(const QString& reason);
+    
+private:
+    bool requestFromListener();
+    void readListenerResponse();
+    bool openNotifySocket();
+    void closeNotifySocket();
+    void readNotifications();
+    void probeControlSocket();
+    void onExited();
+    void finish(const QString& error);
+    
+    QTimer* m_timeoutTimer;
+    ProcessWatcher* m_watcher;
+    bool m_finished;
+    
+    int m_notifyFd;
+    QByteArray m_notifyPath;
+    QSocketNotifier* m_notifier;
+    
+    // Fallback without a notify socket
+    QLocalSocket* m_probe;
+    QTimer* m_probeTimer;
+    
+    // Request to an already listening control socket
+    QLocalSocket* m_request;
+    QByteArray m_response;
+};
+
+} // namespace DiscordDrawRPC
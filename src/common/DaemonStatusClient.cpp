@@ -0,0 +1,173 @@
+#include "DaemonStatusClient.h"
+#include "Config.h"
+#include "DaemonIPC.h"
+#include "PlatformUtils.h"
+#include "ProcessWatcher.h"
+#include <QFileInfo>
+#include <QDebug>
+
+namespace DiscordDrawRPC {
+
+// The daemon locks its PID file a moment before its control socket is up
+static constexpr int STARTUP_RETRY_INTERVAL_MS = 200;
+static constexpr int STARTUP_RETRIES = 25;
+static constexpr int SUBSCRIBE_REQUEST_ID = 1;
+
+DaemonStatusClient::DaemonStatusClient(QObject* parent)
+    : QObject(parent)
+    , m_socket(new QLocalSocket(this))
+    , m_pidWatcher(new QFileSystemWatcher(this))
+    , m_retryTimer(new QTimer(this))
+    , m_exitWatcher(nullptr)
+    , m_retries(0)
+{
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(STARTUP_RETRY_INTERVAL_MS);
+    connect(m_retryTimer, &QTimer::timeout, this, &DaemonStatusClient::connectToDaemon);
+    
+    connect(m_socket, &QLocalSocket::connected, this, &DaemonStatusClient::onConnected);
+    connect(m_socket, &QLocalSocket::readyRead, this, &DaemonStatusClient::onReadyRead);
+    connect(m_socket, &QLocalSocket::disconnected, this, &DaemonStatusClient::onDisconnected);
+    connect(m_socket, &QLocalSocket::errorOccurred, this, &DaemonStatusClient::onError);
+    
+    // A starting daemon rewrites its PID file, the very first one creates it
+    connect(m_pidWatcher, &QFileSystemWatcher::fileChanged, this, [this]() {
+        stopWaitingForExit();
+        m_retries = 0;
+        watchPidFile();
+        connectToDaemon();
+    });
+    connect(m_pidWatcher, &QFileSystemWatcher::directoryChanged, this, &DaemonStatusClient::onPidDirectoryChanged);
+    m_pidWatcher->addPath(QFileInfo(Config::instance().getDaemonPidFilePath()).absolutePath());
+    watchPidFile();
+    
+    connectToDaemon();
+}
+
+void DaemonStatusClient::watchPidFile() {
+    // The watch on a file is lost when it gets deleted
+    QString pidFile = Config::instance().getDaemonPidFilePath();
+    if (!m_pidWatcher->files().contains(pidFile) && QFileInfo::exists(pidFile)) {
+        m_pidWatcher->addPath(pidFile);
+    }
+}
+
+void DaemonStatusClient::onPidDirectoryChanged() {
+    watchPidFile();
+    if (!m_status.running) {
+        connectToDaemon();
+    }
+}
+
+void DaemonStatusClient::waitForExit() {
+    if (m_exitWatcher) {
+        return;
+    }
+    
+    // The PID file stays behind, only the process going away says the lock
+    // was released
+    qint64 pid = ProcessUtils::readPidFile(Config::instance().getDaemonPidFilePath());
+    m_exitWatcher = new ProcessWatcher(pid, this);
+    connect(m_exitWatcher, &ProcessWatcher::exited, this, [this]() {
+        stopWaitingForExit();
+        connectToDaemon();
+    });
+}
+
+void DaemonStatusClient::stopWaitingForExit() {
+    if (m_exitWatcher) {
+        m_exitWatcher->deleteLater();
+        m_exitWatcher = nullptr;
+    }
+}
+
+void DaemonStatusClient::connectToDaemon() {
+    if (m_socket->state() != QLocalSocket::UnconnectedState || m_exitWatcher) {
+        return;
+    }
+    
+    // Nothing to subscribe to until a daemon holds the PID file
+    if (!ProcessUtils::isDaemonRunning()) {
+        m_retries = 0;
+        return;
+    }
+    
+    m_buffer.clear();
+    m_socket->connectToServer(Config::instance().getControlSocketPath());
+}
+
+void DaemonStatusClient::onConnected() {
+    QJsonObject request;
+    request["id"] = SUBSCRIBE_REQUEST_ID;
+    request["op"] = "subscribe";
+    m_socket->write(DaemonProtocol::encode(request));
+}
+
+void DaemonStatusClient::onReadyRead() {
+    m_buffer.append(m_socket->readAll());
+    
+    QJsonObject message;
+    DaemonProtocol::DecodeResult result;
+    while ((result = DaemonProtocol::decode(m_buffer, message)) == DaemonProtocol::DecodeResult::Message) {
+        // The subscription's reply and every event carry the full status
+        QJsonObject status = message.value("status").toObject();
+        if (status.isEmpty()) {
+            continue;
+        }
+        
+        // The daemon is going away, its socket may outlive it
+        if (message.value("event").toString() == "stopping") {
+            waitForExit();
+            m_socket->disconnectFromServer();
+            setStatus(Status());
+            return;
+        }
+        
+        Status next;
+        next.running = status.value("running").toBool();
+        next.discordConnected = status.value("discord_connected").toBool();
+        next.presenceActive = status.value("presence_active").toBool();
+        next.details = status.value("details").toString();
+        m_retries = 0;
+        setStatus(next);
+    }
+    
+    if (result == DaemonProtocol::DecodeResult::Invalid) {
+        qWarning() << "Invalid message from daemon control socket";
+        m_socket->abort();
+    }
+}
+
+void DaemonStatusClient::onDisconnected() {
+    setStatus(Status());
+    
+    // Another daemon may have been started in the meantime, unless this one
+    // said it was stopping and still holds the PID file
+    connectToDaemon();
+}
+
+void DaemonStatusClient::onError(QLocalSocket::LocalSocketError error) {
+    if (error == QLocalSocket::PeerClosedError || m_socket->state() != QLocalSocket::UnconnectedState) {
+        return;
+    }
+    
+    // The daemon may not be listening yet, give it a few seconds
+    if (m_retries < STARTUP_RETRIES) {
+        m_retries++;
+        m_retryTimer->start();
+    }
+}
+
+void DaemonStatusClient::setStatus(const Status& status) {
+    if (status.running == m_status.running
+        && status.discordConnected == m_status.discordConnected
+        && status.presenceActive == m_status.presenceActive
+        && status.details == m_status.details) {
+        return;
+    }
+    
+    m_status = status;
+    emit statusChanged();
+}
+
+} // namespace DiscordDrawRPC
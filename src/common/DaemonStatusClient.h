@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QObject>
+#include <QLocalSocket>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+namespace DiscordDrawRPC {
+
+class ProcessWatcher;
+
+/**
+ * Follows the daemon's status through a "subscribe" request on its control
+ * socket instead of polling. While the daemon isn't running the client
+ * watches its PID file and subscribes again as soon as a daemon starts.
+ * A daemon that announced it is stopping is left alone until it has exited,
+ * connecting to a socket activated one would only get it started again.
+ */
+class DaemonStatusClient : public QObject {
+    Q_OBJECT
+    
+public:
+    struct Status {
+        bool running = false;
+        bool discordConnected = false;
+        bool presenceActive = false;
+        // Details line of the presence shown, empty without one
+        QString details;
+    };
+    
+    explicit DaemonStatusClient(QObject* parent = nullptr);
+    
+    const Status& status() const { return m_status; }
+    
+signals:
+    void statusChanged();
+    
+private slots:
+    void connectToDaemon();
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void onError(QLocalSocket::LocalSocketError error);
+    void onPidDirectoryChanged();
+    
+private:
+    void setStatus(const Status& status);
+    void watchPidFile();
+    void waitForExit();
+    void stopWaitingForExit();
+    
+    QLocalSocket* m_socket;
+    QFileSystemWatcher* m_pidWatcher;
+    QTimer* m_retryTimer;
+    // Set from the "stopping" event until that daemon's process is gone
+    ProcessWatcher* m_exitWatcher;
+    int m_retries;
+    QByteArray m_buffer;
+    Status m_status;
+};
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,28 @@
+#include "NotifySocket.h"
+
+#ifndef _WIN32
+#include <cstddef>
+#include <cstring>
+#endif
+
+namespace DiscordDrawRPC {
+
+#ifndef _WIN32
+socklen_t notifySocketAddress(const QByteArray& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.isEmpty() || path.size() >= static_cast<qsizetype>(sizeof(address.sun_path))) {
+        return 0;
+    }
+    std::memcpy(address.sun_path, path.constData(), path.size());
+    
+    // Abstract names have no terminator, paths keep theirs
+    bool abstract = path.startsWith('@');
+    if (abstract) {
+        address.sun_path[0] = '\0';
+    }
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + (abstract ? 0 : 1));
+}
+#endif
+
+} // namespace DiscordDrawRPC
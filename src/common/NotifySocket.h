@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QByteArray>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace DiscordDrawRPC {
+
+// Environment variable naming the datagram socket to notify, as systemd sets
+// it for Type=notify services, and the states sent on it
+constexpr char NOTIFY_SOCKET_ENV[] = "NOTIFY_SOCKET";
+constexpr char NOTIFY_READY[] = "READY=1";
+constexpr char NOTIFY_STOPPING[] = "STOPPING=1";
+
+#ifndef _WIN32
+// Address of the notify socket at path, '@' standing for the abstract
+// namespace. Shared by the daemon sending on it and the launcher bound to
+// it, so both agree on the length. Returns 0 if the path doesn't fit.
+socklen_t notifySocketAddress(const QByteArray& path, sockaddr_un& address);
+#endif
+
+} // namespace DiscordDrawRPC
@@ -1,21 +1,44 @@
 #include "PlatformUtils.h"
 #include "Config.h"
 #include <QFile>
+#include <QHash>
 #include <QTextStream>
 #include <QDebug>
 
 #ifdef _WIN32
 #include <windows.h>
-#include <tlhelp32.h>
 #else
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/types.h>
-#include <fstream>
+#include <cerrno>
 #endif
 
 namespace DiscordDrawRPC {
 
+#ifdef _WIN32
+using LockHandle = HANDLE;
+
+// Locks on Windows are mandatory, so the locked byte lies far past the
+// PID itself where it doesn't get in the way of readPidFile()
+static OVERLAPPED lockRegion() {
+    OVERLAPPED region = {};
+    region.OffsetHigh = 0x7FFFFFFF;
+    return region;
+}
+#else
+using LockHandle = int;
+#endif
+
+// PID files this process holds the lock of
+static QHash<QString, LockHandle>& heldLocks() {
+    static QHash<QString, LockHandle> locks;
+    return locks;
+}
+
 bool ProcessUtils::isProcessRunning(qint64 pid) {
     if (pid <= 0) return false;
     
@@ -67,138 +90,138 @@ qint64 ProcessUtils::readPidFile(const QString& filePath) {
     return ok ? pid : -1;
 }
 
-bool ProcessUtils::writePidFile(const QString& filePath, qint64 pid) {
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        qWarning() << "Failed to write PID file:" << filePath;
-        return false;
+bool ProcessUtils::lockPidFile(const QString& filePath, qint64 pid) {
+    if (heldLocks().contains(filePath)) {
+        return true;
     }
     
-    QTextStream out(&file);
-    out << pid;
-    file.close();
-    
-    return true;
-}
+    QByteArray pidText = QByteArray::number(pid);
 
-bool ProcessUtils::isProcessRunningByName(qint64 pid, const QString& namePattern) {
-    if (!isProcessRunning(pid)) {
-        return false;
-    }
-    
 #ifdef _WIN32
-    // On Windows, enumerate processes and check name
-    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (snapshot == INVALID_HANDLE_VALUE) {
+    // Not inheritable, so processes we launch don't end up holding it
+    HANDLE file = CreateFileW(reinterpret_cast<const wchar_t*>(filePath.utf16()),
+                              GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        qWarning() << "Failed to open PID file:" << filePath;
         return false;
     }
     
-    PROCESSENTRY32 entry;
-    entry.dwSize = sizeof(PROCESSENTRY32);
-    
-    bool found = false;
-    if (Process32First(snapshot, &entry)) {
-        do {
-            if (entry.th32ProcessID == static_cast<DWORD>(pid)) {
-                QString exeFile = QString::fromWCharArray(entry.szExeFile);
-                found = exeFile.contains(namePattern, Qt::CaseInsensitive);
-                break;
-            }
-        } while (Process32Next(snapshot, &entry));
+    OVERLAPPED region = lockRegion();
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &region)) {
+        CloseHandle(file);
+        return false;
     }
     
-    CloseHandle(snapshot);
-    return found;
+    DWORD written = 0;
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(file);
+    WriteFile(file, pidText.constData(), static_cast<DWORD>(pidText.size()), &written, NULL);
 #else
-    // On Linux, read /proc/[pid]/cmdline
-    QString cmdlinePath = QString("/proc/%1/cmdline").arg(pid);
-    std::ifstream cmdlineFile(cmdlinePath.toStdString());
-    
-    if (!cmdlineFile.is_open()) {
-        // Process might have exited or we don't have permission
-        return false;
+    QByteArray path = QFile::encodeName(filePath);
+    int fd;
+    for (;;) {
+        // Close-on-exec, so processes we launch don't end up holding it
+        fd = ::open(path.constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            qWarning() << "Failed to open PID file:" << filePath;
+            return false;
+        }
+        
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            ::close(fd);
+            return false;
+        }
+        
+        // Retry if the file was deleted or replaced before we got the lock
+        struct stat held, current;
+        if (fstat(fd, &held) == 0 && stat(path.constData(), &current) == 0
+            && held.st_dev == current.st_dev && held.st_ino == current.st_ino) {
+            break;
+        }
+        ::close(fd);
     }
     
-    std::string cmdline;
-    std::getline(cmdlineFile, cmdline);
-    cmdlineFile.close();
-    
-    QString cmdlineStr = QString::fromStdString(cmdline);
-    return cmdlineStr.contains(namePattern, Qt::CaseInsensitive);
+    if (ftruncate(fd, 0) != 0 || ::write(fd, pidText.constData(), pidText.size()) != pidText.size()) {
+        qWarning() << "Failed to write PID file:" << filePath;
+    }
+    LockHandle file = fd;
 #endif
+
+    heldLocks().insert(filePath, file);
+    return true;
 }
 
-bool ProcessUtils::isGuiRunning() {
-    QString guiPidFile = Config::instance().getGuiPidFilePath();
-    qint64 pid = readPidFile(guiPidFile);
-    
-    if (pid <= 0) {
-        return false;
-    }
-    
-    if (!isProcessRunning(pid)) {
-        QFile::remove(guiPidFile);
-        return false;
+void ProcessUtils::unlockPidFile(const QString& filePath) {
+    if (!heldLocks().contains(filePath)) {
+        return;
     }
     
+    // Closing the handle drops the lock
+    LockHandle file = heldLocks().take(filePath);
 #ifdef _WIN32
-    return isProcessRunningByName(pid, "DiscordDrawingRPC");
+    CloseHandle(file);
 #else
-    return isProcessRunningByName(pid, "discord-drawing-rpc");
+    ::close(file);
 #endif
 }
 
-bool ProcessUtils::isTrayRunning() {
-    QString trayPidFile = Config::instance().getTrayPidFilePath();
-    qint64 pid = readPidFile(trayPidFile);
-    
-    if (pid <= 0) {
+bool ProcessUtils::isPidFileLocked(const QString& filePath) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(reinterpret_cast<const wchar_t*>(filePath.utf16()),
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
         return false;
     }
     
-    if (!isProcessRunning(pid)) {
-        QFile::remove(trayPidFile);
+    OVERLAPPED region = lockRegion();
+    bool locked = !LockFileEx(file, LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &region);
+    if (!locked) {
+        region = lockRegion();
+        UnlockFileEx(file, 0, 1, 0, &region);
+    }
+    CloseHandle(file);
+    return locked;
+#else
+    int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return false;
     }
     
-#ifdef _WIN32
-    return isProcessRunningByName(pid, "DiscordDrawingRPCTray");
-#else
-    return isProcessRunningByName(pid, "discord-drawing-rpc-tray");
+    // A shared lock only conflicts with the owner's exclusive one
+    bool locked = flock(fd, LOCK_SH | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+    ::close(fd);
+    return locked;
 #endif
 }
 
+bool ProcessUtils::isGuiRunning() {
+    return isPidFileLocked(Config::instance().getGuiPidFilePath());
+}
+
+bool ProcessUtils::isTrayRunning() {
+    return isPidFileLocked(Config::instance().getTrayPidFilePath());
+}
+
 bool ProcessUtils::isDaemonRunning() {
-    QString pidFile = Config::instance().getDaemonPidFilePath();
-    qint64 pid = readPidFile(pidFile);
-    
-    if (pid <= 0) {
-        return false;
-    }
-    
-    if (!isProcessRunning(pid)) {
-        QFile::remove(pidFile);
-        return false;
-    }
-    
-#ifdef _WIN32
-    return isProcessRunningByName(pid, "DiscordDrawingRPCDaemon");
-#else
-    return isProcessRunningByName(pid, "discord-drawing-rpc-daemon");
-#endif
+    return isPidFileLocked(Config::instance().getDaemonPidFilePath());
 }
 
 bool ProcessUtils::terminateProcessFromPidFile(const QString& pidFilePath) {
-    qint64 pid = readPidFile(pidFilePath);
+    // Without the lock the PID may already belong to an unrelated process
+    if (!isPidFileLocked(pidFilePath)) {
+        return false;
+    }
     
+    qint64 pid = readPidFile(pidFilePath);
     if (pid <= 0) {
         return false;
     }
     
-    bool success = killProcess(pid);
-    QFile::remove(pidFilePath);
-    
-    return success;
+    return killProcess(pid);
 }
 
 } // namespace DiscordDrawRPC
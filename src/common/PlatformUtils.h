@@ -16,11 +16,17 @@ public:
     // Read PID from file
     static qint64 readPidFile(const QString& filePath);
     
-    // Write PID to file
-    static bool writePidFile(const QString& filePath, qint64 pid);
+    // Take an exclusive lock on the PID file and write the PID into it.
+    // The lock is held until unlockPidFile() or until the process exits,
+    // so it is never left behind by a crash. Returns false if another
+    // process holds it.
+    static bool lockPidFile(const QString& filePath, qint64 pid);
     
-    // Check if a specific process (by name pattern) is running
-    static bool isProcessRunningByName(qint64 pid, const QString& namePattern);
+    // Release a lock taken with lockPidFile(), the file itself stays
+    static void unlockPidFile(const QString& filePath);
+    
+    // Check if a live process holds the PID file's lock
+    static bool isPidFileLocked(const QString& filePath);
     
     // Check if GUI is running
     static bool isGuiRunning();
@@ -31,7 +37,7 @@ public:
     // Check if Daemon is running
     static bool isDaemonRunning();
     
-    // Terminate process from PID file and clean up the file
+    // Terminate the process holding the PID file
     static bool terminateProcessFromPidFile(const QString& pidFilePath);
 };
 
@@ -0,0 +1,119 @@
+#include "ProcessWatcher.h"
+#include "PlatformUtils.h"
+
+#ifdef _WIN32
+#include <QWinEventNotifier>
+#include <windows.h>
+#else
+#include <QSocketNotifier>
+#include <unistd.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace DiscordDrawRPC {
+
+// Fallback when the OS can't tell us about the exit
+static const int POLL_INTERVAL_MS = 100;
+
+ProcessWatcher::ProcessWatcher(qint64 pid, QObject* parent)
+    : QObject(parent)
+    , m_pid(pid)
+    , m_finished(false)
+    , m_timeoutTimer(nullptr)
+    , m_pollTimer(nullptr)
+#ifdef _WIN32
+    , m_process(nullptr)
+#else
+    , m_pidfd(-1)
+#endif
+    , m_notifier(nullptr)
+{
+    bool gone = pid <= 0;
+
+#ifdef _WIN32
+    if (!gone) {
+        m_process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+        if (m_process) {
+            // Signaled once the process has exited
+            m_notifier = new QWinEventNotifier(m_process, this);
+            connect(m_notifier, &QWinEventNotifier::activated, this, [this]() { finish(true); });
+        } else {
+            gone = !ProcessUtils::isProcessRunning(pid);
+        }
+    }
+#elif defined(__linux__) && defined(SYS_pidfd_open)
+    if (!gone) {
+        m_pidfd = static_cast<int>(syscall(SYS_pidfd_open, static_cast<pid_t>(pid), 0));
+        if (m_pidfd >= 0) {
+            // A pidfd polls readable once the process has exited
+            m_notifier = new QSocketNotifier(m_pidfd, QSocketNotifier::Read, this);
+            connect(m_notifier, &QSocketNotifier::activated, this, [this]() { finish(true); });
+        } else {
+            gone = errno == ESRCH;
+        }
+    }
+#endif
+
+    if (gone) {
+        // Let the caller connect before telling them
+        QTimer::singleShot(0, this, [this]() { finish(true); });
+    } else if (!m_notifier) {
+        m_pollTimer = new QTimer(this);
+        connect(m_pollTimer, &QTimer::timeout, this, [this]() {
+            if (!ProcessUtils::isProcessRunning(m_pid)) {
+                finish(true);
+            }
+        });
+        m_pollTimer->start(POLL_INTERVAL_MS);
+    }
+}
+
+ProcessWatcher::~ProcessWatcher() {
+    delete m_notifier;
+#ifdef _WIN32
+    if (m_process) {
+        CloseHandle(m_process);
+    }
+#else
+    if (m_pidfd >= 0) {
+        ::close(m_pidfd);
+    }
+#endif
+}
+
+void ProcessWatcher::setTimeout(int timeoutMs) {
+    if (!m_timeoutTimer) {
+        m_timeoutTimer = new QTimer(this);
+        m_timeoutTimer->setSingleShot(true);
+        connect(m_timeoutTimer, &QTimer::timeout, this, [this]() { finish(false); });
+    }
+    m_timeoutTimer->start(timeoutMs);
+}
+
+void ProcessWatcher::finish(bool exited) {
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+    }
+    if (m_pollTimer) {
+        m_pollTimer->stop();
+    }
+    if (m_timeoutTimer) {
+        m_timeoutTimer->stop();
+    }
+    
+    if (exited) {
+        emit this->exited();
+    } else {
+        emit timedOut();
+    }
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+class QSocketNotifier;
+class QWinEventNotifier;
+
+namespace DiscordDrawRPC {
+
+/**
+ * Notifies when a process exits, without polling where the OS allows it.
+ * Linux uses a pidfd (kernel 5.3+) and Windows the process handle, both
+ * of which refer to that exact process even if its PID gets reused.
+ * Elsewhere, or when no pidfd can be opened, the PID is polled instead.
+ */
+class ProcessWatcher : public QObject {
+    Q_OBJECT
+    
+public:
+    explicit ProcessWatcher(qint64 pid, QObject* parent = nullptr);
+    ~ProcessWatcher();
+    
+    // Emit timedOut() if the process is still running after timeoutMs
+    void setTimeout(int timeoutMs);
+    
+signals:
+    void exited();
+    void timedOut();
+    
+private:
+    void finish(bool exited);
+    
+    qint64 m_pid;
+    bool m_finished;
+    QTimer* m_timeoutTimer;
+    QTimer* m_pollTimer;
+#ifdef _WIN32
+    void* m_process;
+    QWinEventNotifier* m_notifier;
+#else
+    int m_pidfd;
+    QSocketNotifier* m_notifier;
+#endif
+};
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,372 @@
+#include "AsyncLogger.h"
+#include <QDateTime>
+#include <QSaveFile>
+#include <QtEndian>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace DiscordDrawRPC {
+
+static_assert((AsyncLogger::CAPACITY & (AsyncLogger::CAPACITY - 1)) == 0,
+              "Ring capacity must be a power of two");
+
+// Rotated logs are compressed this much at a time
+static constexpr qint64 GZIP_CHUNK_SIZE = 1024 * 1024;
+              
+static const char* typeName(QtMsgType type) {
+    switch (type) {
+        case QtDebugMsg:
+            return "DEBUG";
+        case QtInfoMsg:
+            return "INFO";
+        case QtWarningMsg:
+            return "WARNING";
+        case QtCriticalMsg:
+            return "CRITICAL";
+        case QtFatalMsg:
+            return "FATAL";
+    }
+    return "UNKNOWN";
+}
+
+// CRC-32 as used by gzip (reflected polynomial 0xEDB88320)
+static constexpr std::array<quint32, 256> makeCrcTable() {
+    std::array<quint32, 256> table {};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+static quint32 crc32(const QByteArray& data) {
+    static constexpr std::array<quint32, 256> table = makeCrcTable();
+    
+    quint32 crc = 0xFFFFFFFFu;
+    for (char byte : data) {
+        crc = table[(crc ^ static_cast<quint8>(byte)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Append one gzip member holding data
+static bool writeGzipMember(QIODevice& output, const QByteArray& data) {
+    // qCompress() produces [uint32 size][zlib header: 2][deflate][adler32: 4],
+    // gzip wants the bare deflate stream with its own header and trailer
+    QByteArray zlib = qCompress(data, 9);
+    if (zlib.size() < 10) {
+        return false;
+    }
+    
+    static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 2, '\xff' };
+    char trailer[8];
+    qToLittleEndian<quint32>(crc32(data), trailer);
+    qToLittleEndian<quint32>(static_cast<quint32>(data.size()), trailer + 4);
+    
+    return output.write(header, sizeof(header)) == sizeof(header)
+        && output.write(zlib.constData() + 6, zlib.size() - 10) == zlib.size() - 10
+        && output.write(trailer, sizeof(trailer)) == sizeof(trailer);
+}
+
+// Compress a file into a .gz archive and remove the original. Every chunk
+// becomes a gzip member of its own, which gunzip reads back as one stream,
+// so memory use doesn't grow with the configured rotation size.
+static bool gzipFile(const QString& source, const QString& target) {
+    QFile input(source);
+    if (!input.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QSaveFile output(target);
+    if (!output.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    
+    // An empty log still makes a valid, empty archive
+    bool first = true;
+    for (;;) {
+        QByteArray chunk = input.read(GZIP_CHUNK_SIZE);
+        if (input.error() != QFileDevice::NoError) {
+            return false;
+        }
+        if (chunk.isEmpty() && !first) {
+            break;
+        }
+        if (!writeGzipMember(output, chunk)) {
+            return false;
+        }
+        first = false;
+    }
+    input.close();
+    
+    if (!output.commit()) {
+        return false;
+    }
+    
+    return QFile::remove(source);
+}
+
+AsyncLogger::AsyncLogger()
+    : m_slots(new Slot[CAPACITY])
+    , m_enqueuePos(0)
+    , m_dequeuePos(0)
+    , m_dropped(0)
+    , m_running(false)
+    , m_urgent(false)
+    , m_maxBytes(0)
+    , m_maxArchives(0)
+    , m_rotateRetrySize(0)
+    , m_prefixSecond(-1)
+    , m_reportedDropped(0)
+{
+    // Slot i is free for the producer whose position is i
+    for (size_t i = 0; i < CAPACITY; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+AsyncLogger::~AsyncLogger() {
+    stop();
+}
+
+bool AsyncLogger::open(const QString& path) {
+    m_file.setFileName(path);
+    return m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+}
+
+void AsyncLogger::setRotation(qint64 maxBytes, int maxArchives) {
+    m_maxBytes.store(qMax<qint64>(0, maxBytes), std::memory_order_relaxed);
+    m_maxArchives.store(qMax(0, maxArchives), std::memory_order_relaxed);
+}
+
+void AsyncLogger::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+    m_thread = std::thread(&AsyncLogger::run, this);
+}
+
+void AsyncLogger::stop() {
+    // Changed under the writer's mutex, so it can't be missed between the
+    // writer checking its wait condition and going to sleep
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (!m_running.exchange(false)) {
+            return;
+        }
+    }
+    
+    m_wake.notify_one();
+    m_thread.join();
+    m_file.close();
+    
+    if (m_compressThread.joinable()) {
+        m_compressThread.join();
+    }
+}
+
+void AsyncLogger::log(QtMsgType type, const char* category, const QString& message) {
+    qint64 timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+        
+    // Claim a slot; a producer that finds the ring full drops the message
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &m_slots[pos & (CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    
+    slot->type = type;
+    slot->category = category;
+    slot->timestamp = timestamp;
+    slot->message = message;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    
+    // Problems are written out right away instead of on the next interval
+    // (set under the writer's mutex, or the wakeup may be lost)
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_urgent.store(true, std::memory_order_relaxed);
+        }
+        m_wake.notify_one();
+    }
+}
+
+bool AsyncLogger::dequeue(Slot& out) {
+    Slot& slot = m_slots[m_dequeuePos & (CAPACITY - 1)];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != m_dequeuePos + 1) {
+        return false;
+    }
+    
+    out.type = slot.type;
+    out.category = slot.category;
+    out.timestamp = slot.timestamp;
+    out.message = std::move(slot.message);
+    slot.message = QString();
+    
+    // Hand the slot back to the producer one lap ahead
+    slot.sequence.store(m_dequeuePos + CAPACITY, std::memory_order_release);
+    m_dequeuePos++;
+    return true;
+}
+
+void AsyncLogger::run() {
+    Slot entry;
+    
+    for (;;) {
+        bool running = m_running.load(std::memory_order_acquire);
+        
+        while (dequeue(entry)) {
+            format(entry.type, entry.category, entry.timestamp, entry.message);
+        }
+        
+        quint64 dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDropped) {
+            format(QtWarningMsg, nullptr, QDateTime::currentMSecsSinceEpoch(),
+                   QString("Log buffer full, dropped %1 messages").arg(dropped - m_reportedDropped));
+            m_reportedDropped = dropped;
+        }
+        
+        writeBatch();
+        
+        if (!running) {
+            // Everything logged before stop() has been written
+            break;
+        }
+        
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this]() {
+            return m_urgent.load(std::memory_order_relaxed) || !m_running.load(std::memory_order_relaxed);
+        });
+        m_urgent.store(false, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLogger::format(QtMsgType type, const char* category, qint64 timestamp, const QString& message) {
+    // The date only has to be formatted once per second
+    qint64 second = timestamp / 1000;
+    if (second != m_prefixSecond) {
+        m_prefixSecond = second;
+        m_prefix = "[";
+        m_prefix.append(QDateTime::fromMSecsSinceEpoch(timestamp).toString("yyyy-MM-dd HH:mm:ss").toUtf8());
+        m_prefix.append("] [");
+    }
+    
+    m_batch.append(m_prefix);
+    m_batch.append(typeName(type));
+    m_batch.append("] ");
+    // Messages logged without a category go to Qt's "default" one
+    if (category && std::strcmp(category, "default") != 0) {
+        m_batch.append(category);
+        m_batch.append(": ");
+    }
+    m_batch.append(message.toUtf8());
+    m_batch.append('\n');
+}
+
+void AsyncLogger::writeBatch() {
+    if (m_batch.isEmpty()) {
+        return;
+    }
+    
+    std::fwrite(m_batch.constData(), 1, m_batch.size(), stderr);
+    
+    bool warn = false;
+    if (m_file.isOpen()) {
+        m_file.write(m_batch);
+        m_file.flush();
+        
+        // Asks the file system, so a log cleared from the GUI starts over
+        qint64 maxBytes = m_maxBytes.load(std::memory_order_relaxed);
+        qint64 size = m_file.size();
+        if (size < maxBytes) {
+            m_rotateRetrySize = 0;
+        }
+        if (maxBytes > 0 && size >= qMax(maxBytes, m_rotateRetrySize)) {
+            if (rotate()) {
+                m_rotateRetrySize = 0;
+            } else {
+                // Tried again once the log grew by another limit rather than
+                // on every batch, the file stays where it is meanwhile
+                warn = m_rotateRetrySize == 0;
+                m_rotateRetrySize = size + maxBytes;
+            }
+        }
+    }
+    
+    // Keeps the allocation for the next batch
+    m_batch.resize(0);
+    
+    // Goes out with the next batch, once per run of failures
+    if (warn) {
+        format(QtWarningMsg, nullptr, QDateTime::currentMSecsSinceEpoch(),
+               QString("Failed to rotate %1, it may be open elsewhere; retrying at %2 bytes")
+                   .arg(m_file.fileName()).arg(m_rotateRetrySize));
+    }
+}
+
+QString AsyncLogger::archivePath(int generation) const {
+    return QString("%1.%2.gz").arg(m_file.fileName()).arg(generation);
+}
+
+bool AsyncLogger::rotate() {
+    QString path = m_file.fileName();
+    QString pending = path + ".1";
+    m_file.close();
+    
+    // The previous archive has to be finished before it can be moved up
+    if (m_compressThread.joinable()) {
+        m_compressThread.join();
+    }
+    
+    // Archives only move up once the log itself could be moved out of the
+    // way, which fails on Windows while the log viewer has it mapped
+    bool moved;
+    int maxArchives = m_maxArchives.load(std::memory_order_relaxed);
+    if (maxArchives == 0) {
+        moved = QFile::remove(path);
+    } else {
+        QFile::remove(pending);
+        moved = QFile::rename(path, pending);
+        if (moved) {
+            QFile::remove(archivePath(maxArchives));
+            for (int generation = maxArchives - 1; generation >= 1; --generation) {
+                QFile::rename(archivePath(generation), archivePath(generation + 1));
+            }
+            
+            QString archive = archivePath(1);
+            m_compressThread = std::thread([pending, archive]() {
+                if (!gzipFile(pending, archive)) {
+                    std::fprintf(stderr, "Failed to compress %s\n", qPrintable(pending));
+                }
+            });
+        }
+    }
+    
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        std::fprintf(stderr, "Failed to reopen log file %s\n", qPrintable(path));
+    }
+    return moved;
+}
+
+} // namespace DiscordDrawRPC
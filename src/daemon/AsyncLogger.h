@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Log sink that keeps file and console I/O off the logging threads.
+ * Messages go into a bounded multi-producer ring buffer (a Vyukov queue)
+ * without taking a lock; a background thread formats them in batches and
+ * writes them out. The file is flushed every FLUSH_INTERVAL_MS, or right
+ * away once a warning or worse is logged. When the ring is full messages
+ * are dropped and counted rather than blocking the caller.
+ * 
+ * Once the file grows past the size limit it is rotated: the old file
+ * becomes <file>.1.gz, older archives move up one number and those beyond
+ * the kept generations are deleted. Compression runs on its own thread.
+ */
+class AsyncLogger {
+public:
+    static constexpr size_t CAPACITY = 8192;
+    static constexpr int FLUSH_INTERVAL_MS = 250;
+    
+    AsyncLogger();
+    ~AsyncLogger();
+    
+    // Append to the given file, returns false if it can't be opened
+    bool open(const QString& path);
+    // Rotate past maxBytes (0 to never rotate), keeping maxArchives compressed
+    // generations; may be changed while running
+    void setRotation(qint64 maxBytes, int maxArchives);
+    void start();
+    // Write out everything queued so far and stop the writer thread
+    void stop();
+    
+    // Safe to call from any thread and never waits for the writer, warnings
+    // and worse only take its mutex for a moment to wake it; the category
+    // name must outlive the logger, as those of QLoggingCategory do
+    void log(QtMsgType type, const char* category, const QString& message);
+    
+    quint64 droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+    
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        QtMsgType type;
+        const char* category;
+        qint64 timestamp;
+        QString message;
+    };
+    
+    bool dequeue(Slot& out);
+    void run();
+    void format(QtMsgType type, const char* category, qint64 timestamp, const QString& message);
+    void writeBatch();
+    // Returns false if the log couldn't be moved out of the way
+    bool rotate();
+    QString archivePath(int generation) const;
+    
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) size_t m_dequeuePos;
+    std::atomic<quint64> m_dropped;
+    
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_urgent;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+    
+    // Changed by setRotation() while the writer runs
+    std::atomic<qint64> m_maxBytes;
+    std::atomic<int> m_maxArchives;
+    
+    // Only touched by the writer thread
+    QFile m_file;
+    std::thread m_compressThread;
+    // Size to try rotating again at after a failure, 0 when the last one worked
+    qint64 m_rotateRetrySize;
+    QByteArray m_batch;
+    qint64 m_prefixSecond;
+    QByteArray m_prefix;
+    quint64 m_reportedDropped;
+};
+
+} // namespace DiscordDrawRPC
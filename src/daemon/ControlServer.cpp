@@ -0,0 +1,173 @@
+#include "ControlServer.h"
+#include "LogCategories.h"
+#include "../common/DaemonIPC.h"
+#include <QSocketNotifier>
+#include <QDebug>
+
+namespace DiscordDrawRPC {
+
+// A subscriber this far behind isn't reading its events anymore
+static constexpr qint64 MAX_SUBSCRIBER_BACKLOG = DaemonProtocol::MAX_MESSAGE_SIZE;
+
+ControlServer::ControlServer(QObject* parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_activated(false)
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection,
+            this, &ControlServer::onNewConnection);
+}
+
+ControlServer::~ControlServer() {
+    close();
+}
+
+bool ControlServer::listen(const QString& name) {
+    // A crashed daemon may have left a stale socket behind
+    QLocalServer::removeServer(name);
+    
+    if (!m_server->listen(name)) {
+        qCWarning(lcDaemonLifecycle) << "Failed to listen on control socket:" << name << m_server->errorString();
+        return false;
+    }
+    
+    qCInfo(lcDaemonLifecycle) << "Control socket listening:" << m_server->fullServerName();
+    return true;
+}
+
+bool ControlServer::listen(qintptr socketDescriptor) {
+    if (!m_server->listen(socketDescriptor)) {
+        qCWarning(lcDaemonLifecycle) << "Failed to listen on activated control socket:" << m_server->errorString();
+        return false;
+    }
+    
+    m_activated = true;
+    qCInfo(lcDaemonLifecycle) << "Control socket activated:" << m_server->fullServerName();
+    return true;
+}
+
+void ControlServer::close() {
+    for (QLocalSocket* client : m_buffers.keys()) {
+        client->disconnect(this);
+        client->disconnectFromServer();
+        client->deleteLater();
+    }
+    m_buffers.clear();
+    m_subscribers.clear();
+    
+    if (m_activated) {
+        // Closing unlinks the socket file, cutting the activator off from
+        // the next client, so the descriptor goes with the process instead.
+        // The server's notifier would keep accepting until then and the
+        // connections would die with us; stopped, they stay in the backlog
+        // for the next daemon.
+        if (m_server->parent()) {
+            m_server->disconnect(this);
+            m_server->setParent(nullptr);
+            // Accepted before we got to them, they can only reconnect. Taking
+            // one re-enables the notifier, so this goes first.
+            while (QLocalSocket* client = m_server->nextPendingConnection()) {
+                client->abort();
+                delete client;
+            }
+            for (QSocketNotifier* notifier : m_server->findChildren<QSocketNotifier*>()) {
+                notifier->setEnabled(false);
+            }
+        }
+    } else if (m_server->isListening()) {
+        m_server->close();
+    }
+}
+
+void ControlServer::onNewConnection() {
+    while (QLocalSocket* client = m_server->nextPendingConnection()) {
+        m_buffers.insert(client, QByteArray());
+        
+        connect(client, &QLocalSocket::readyRead,
+                this, &ControlServer::onClientReadyRead);
+        connect(client, &QLocalSocket::disconnected,
+                this, &ControlServer::onClientDisconnected);
+    }
+}
+
+void ControlServer::onClientReadyRead() {
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    if (!client || !m_buffers.contains(client)) return;
+    
+    processMessages(client);
+}
+
+void ControlServer::onClientDisconnected() {
+    QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
+    if (!client) return;
+    
+    m_buffers.remove(client);
+    m_subscribers.remove(client);
+    client->deleteLater();
+}
+
+void ControlServer::dropClient(QLocalSocket* client) {
+    m_buffers.remove(client);
+    m_subscribers.remove(client);
+    client->disconnect(this);
+    client->disconnectFromServer();
+    client->deleteLater();
+}
+
+void ControlServer::publish(const QJsonObject& event) {
+    if (m_subscribers.isEmpty()) {
+        return;
+    }
+    
+    QByteArray message = DaemonProtocol::encode(event);
+    const QList<QLocalSocket*> subscribers = m_subscribers.values();
+    for (QLocalSocket* client : subscribers) {
+        if (client->bytesToWrite() > MAX_SUBSCRIBER_BACKLOG) {
+            qCWarning(lcDaemonLifecycle) << "Dropping control client that stopped reading events";
+            dropClient(client);
+            continue;
+        }
+        client->write(message);
+        client->flush();
+    }
+}
+
+void ControlServer::processMessages(QLocalSocket* client) {
+    // Work on a local buffer, the handler may end up closing this client
+    QByteArray buffer = m_buffers.take(client);
+    buffer.append(client->readAll());
+    
+    QJsonObject request;
+    DaemonProtocol::DecodeResult result;
+    while ((result = DaemonProtocol::decode(buffer, request)) == DaemonProtocol::DecodeResult::Message) {
+        QJsonObject response;
+        if (m_handler) {
+            response = m_handler(request);
+        } else {
+            response["ok"] = false;
+            response["error"] = "Daemon is not ready";
+        }
+        response["id"] = request.value("id");
+        
+        client->write(DaemonProtocol::encode(response));
+        client->flush();
+        
+        // Events only start after the reply carrying the current status
+        if (request.value("op").toString() == "subscribe" && response.value("ok").toBool()) {
+            m_subscribers.insert(client);
+        }
+    }
+    
+    if (result == DaemonProtocol::DecodeResult::Invalid) {
+        qCWarning(lcDaemonLifecycle) << "Dropping control client after malformed message";
+        dropClient(client);
+        return;
+    }
+    
+    if (client->state() == QLocalSocket::ConnectedState) {
+        m_buffers.insert(client, buffer);
+    }
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+#include <QJsonObject>
+#include <functional>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Control socket through which the GUI and tray drive the daemon.
+ * Speaks the length-prefixed JSON protocol described in DaemonIPC.h and
+ * answers every request with the response produced by the request handler.
+ * Clients whose "subscribe" request succeeded also get every event passed
+ * to publish() until they disconnect.
+ */
+class ControlServer : public QObject {
+    Q_OBJECT
+    
+public:
+    using RequestHandler = std::function<QJsonObject(const QJsonObject& request)>;
+    
+    explicit ControlServer(QObject* parent = nullptr);
+    ~ControlServer();
+    
+    bool listen(const QString& name);
+    // Take over a socket that already listens, see takeActivatedSocket()
+    bool listen(qintptr socketDescriptor);
+    void close();
+    bool isActivated() const { return m_activated; }
+    
+    void setRequestHandler(RequestHandler handler) { m_handler = std::move(handler); }
+    
+    // Push an event message to every subscribed client
+    void publish(const QJsonObject& event);
+    int subscriberCount() const { return m_subscribers.size(); }
+    int clientCount() const { return m_buffers.size(); }
+    
+private slots:
+    void onNewConnection();
+    void onClientReadyRead();
+    void onClientDisconnected();
+    
+private:
+    void processMessages(QLocalSocket* client);
+    void dropClient(QLocalSocket* client);
+    
+    QLocalServer* m_server;
+    QHash<QLocalSocket*, QByteArray> m_buffers;
+    QSet<QLocalSocket*> m_subscribers;
+    RequestHandler m_handler;
+    // The socket belongs to whoever activated us and outlives this process
+    bool m_activated;
+};
+
+} // namespace DiscordDrawRPC
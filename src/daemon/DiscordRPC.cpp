@@ -1,17 +1,11 @@
 #include "DiscordRPC.h"
+#include "LogCategories.h"
+#include "Metrics.h"
 #include <QJsonDocument>
 #include <QByteArray>
+#include <QtEndian>
 #include <QDebug>
-#include <QDir>
 #include <QCoreApplication>
-#include <QDateTime>
-#include <QThread>
-
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <unistd.h>
-#endif
 
 namespace DiscordDrawRPC {
 
@@ -24,242 +18,363 @@ enum OpCode {
     PONG = 4
 };
 
-DiscordRPC::DiscordRPC(const QString& clientId, QObject* parent)
+// Connection attempt limits
+static constexpr int PROBE_TIMEOUT_MS = 1000;
+static constexpr int HANDSHAKE_TIMEOUT_MS = 5000;
+static constexpr int COMMAND_TIMEOUT_MS = 30000;
+
+DiscordRPC::DiscordRPC(const QString& clientId, const QString& endpoint, QObject* parent)
     : QObject(parent)
     , m_clientId(clientId)
+    , m_endpoint(endpoint)
     , m_socket(nullptr)
-    , m_connected(false)
-    , m_readBuffer()
+    , m_pid(QCoreApplication::applicationPid())
+    , m_state(State::Idle)
+    , m_nonceCounter(0)
+    , m_drainScheduled(false)
+    , m_timeoutTimer(new QTimer(this))
+    , m_reader()
 {
+    m_timeoutTimer->setSingleShot(true);
+    QObject::connect(m_timeoutTimer, &QTimer::timeout,
+                    this, &DiscordRPC::onTimeout);
 }
 
 DiscordRPC::~DiscordRPC() {
     disconnect();
 }
 
-QString DiscordRPC::getDiscordIpcPath(int pipeNum) {
-#ifdef _WIN32
-    return QString("\\\\.\\pipe\\discord-ipc-%1").arg(pipeNum);
-#else
-    // Try different locations where Discord might create its socket
-    QStringList possiblePaths = {
-        // Flatpak Discord location
-        QString(qEnvironmentVariable("XDG_RUNTIME_DIR")) + QString("/app/com.discordapp.Discord/discord-ipc-%1").arg(pipeNum),
-        // Standard locations
-        QString(qEnvironmentVariable("XDG_RUNTIME_DIR")) + QString("/discord-ipc-%1").arg(pipeNum),
-        QString("/run/user/%1/discord-ipc-%2").arg(getuid()).arg(pipeNum),
-        QString(qEnvironmentVariable("TMPDIR")) + QString("/discord-ipc-%1").arg(pipeNum),
-        QString("/tmp/discord-ipc-%1").arg(pipeNum)
-    };
-    
-    // Return the first path that exists
-    for (const QString& path : possiblePaths) {
-        if (QFile::exists(path)) {
-            return path;
-        }
+void DiscordRPC::connect() {
+    if (m_state != State::Idle) {
+        return;
     }
     
-    // Default to XDG_RUNTIME_DIR or /tmp
-    QString runtimeDir = qEnvironmentVariable("XDG_RUNTIME_DIR");
-    if (!runtimeDir.isEmpty()) {
-        return runtimeDir + QString("/discord-ipc-%1").arg(pipeNum);
-    }
-    return QString("/tmp/discord-ipc-%1").arg(pipeNum);
-#endif
+    Metrics::instance().increment(Metrics::ConnectAttempts);
+    m_state = State::Probing;
+    
+    m_socket = new QLocalSocket(this);
+    
+    QObject::connect(m_socket, &QLocalSocket::connected, 
+                    this, &DiscordRPC::onSocketConnected);
+    QObject::connect(m_socket, &QLocalSocket::disconnected, 
+                    this, &DiscordRPC::onSocketDisconnected);
+    QObject::connect(m_socket, &QLocalSocket::errorOccurred, 
+                    this, &DiscordRPC::onSocketError);
+    QObject::connect(m_socket, &QLocalSocket::readyRead, 
+                    this, &DiscordRPC::onReadyRead);
+                    
+    m_timeoutTimer->start(PROBE_TIMEOUT_MS);
+    
+    // May report success or failure synchronously, nothing may follow this call
+    m_socket->connectToServer(m_endpoint);
+}
+
+void DiscordRPC::failAttempt(const QString& message) {
+    m_timeoutTimer->stop();
+    resetSocket(true);
+    m_state = State::Idle;
+    m_reader.clear();
+    m_pendingCommands.clear();
+    emit error(message);
+}
+
+void DiscordRPC::dropConnection() {
+    resetSocket(true);
+    m_state = State::Idle;
+    m_reader.clear();
+    m_pendingCommands.clear();
+    emit disconnected();
 }
 
-bool DiscordRPC::connect() {
-    if (m_connected) {
-        return true;
+void DiscordRPC::resetSocket(bool abort) {
+    if (!m_socket) {
+        return;
     }
     
-    // Try connecting to different pipe numbers (0-9)
-    for (int i = 0; i < 10; ++i) {
-        QString ipcPath = getDiscordIpcPath(i);
-        
-        m_socket = new QLocalSocket(this);
-        
-        QObject::connect(m_socket, &QLocalSocket::connected, 
-                        this, &DiscordRPC::onSocketConnected);
-        QObject::connect(m_socket, &QLocalSocket::disconnected, 
-                        this, &DiscordRPC::onSocketDisconnected);
-        QObject::connect(m_socket, &QLocalSocket::errorOccurred, 
-                        this, &DiscordRPC::onSocketError);
-        QObject::connect(m_socket, &QLocalSocket::readyRead, 
-                        this, &DiscordRPC::onReadyRead);
-        
-        m_socket->connectToServer(ipcPath);
-        
-        if (m_socket->waitForConnected(1000)) {
-            qDebug() << "Connected to Discord IPC:" << ipcPath;
-            return handshake();
-        } else {
-            m_socket->deleteLater();
-            m_socket = nullptr;
-        }
+    m_socket->disconnect(this);
+    if (abort) {
+        m_socket->abort();
     }
-    
-    emit error("Failed to connect to Discord. Make sure Discord is running.");
-    return false;
+    m_socket->deleteLater();
+    m_socket = nullptr;
 }
 
 void DiscordRPC::disconnect() {
+    m_timeoutTimer->stop();
     if (m_socket) {
+        m_socket->disconnect(this);
         m_socket->disconnectFromServer();
         m_socket->deleteLater();
         m_socket = nullptr;
     }
-    m_connected = false;
-    m_readBuffer.clear();
+    m_state = State::Idle;
+    m_reader.clear();
+    m_pendingCommands.clear();
 }
 
-bool DiscordRPC::handshake() {
+void DiscordRPC::sendHandshake() {
     QJsonObject handshakeData;
     handshakeData["v"] = 1;
     handshakeData["client_id"] = m_clientId;
     
     if (!sendFrame(OpCode::HANDSHAKE, handshakeData)) {
-        return false;
+        failAttempt("Failed to send handshake to Discord");
+        return;
     }
     
     // Wait for READY response with timeout
-    int retries = 50; // 5 seconds total (50 * 100ms)
-    while (!m_connected && retries > 0 && m_socket && m_socket->isOpen()) {
-        m_socket->waitForReadyRead(100);
-        retries--;
-    }
-    
-    return m_connected;
+    m_handshakeTimer.start();
+    m_state = State::Handshaking;
+    m_timeoutTimer->start(HANDSHAKE_TIMEOUT_MS);
 }
 
 bool DiscordRPC::sendFrame(int opcode, const QJsonObject& data) {
-    if (!m_socket || !m_socket->isOpen()) {
-        return false;
-    }
-    
-    QJsonDocument doc(data);
-    QByteArray payload = doc.toJson(QJsonDocument::Compact);
-    
+    return sendFrame(opcode, QJsonDocument(data).toJson(QJsonDocument::Compact));
+}
+
+bool DiscordRPC::sendFrame(int opcode, const QByteArray& payload) {
     // Discord IPC frame format:
     // [opcode: int32][length: int32][payload: json bytes]
     QByteArray frame;
-    QDataStream stream(&frame, QIODevice::WriteOnly);
-    stream.setByteOrder(QDataStream::LittleEndian);
+    frame.reserve(8 + payload.size());
     
-    stream << static_cast<qint32>(opcode);
-    stream << static_cast<qint32>(payload.size());
+    char header[8];
+    qToLittleEndian<qint32>(opcode, header);
+    qToLittleEndian<qint32>(static_cast<qint32>(payload.size()), header + 4);
+    frame.append(header, 8);
     frame.append(payload);
     
-    qint64 written = m_socket->write(frame);
+    return writeFrame(frame);
+}
+
+bool DiscordRPC::writeFrame(const QByteArray& frame) {
+    if (!m_socket || !m_socket->isOpen()) {
+        return false;
+    }
+    
+    qCDebug(lcRpcFrames).noquote() << "Sending frame" << qFromLittleEndian<qint32>(frame.constData())
+                                   << QByteArray::fromRawData(frame.constData() + 8, frame.size() - 8);
+    
+    qint64 written = m_socket->write(frame.constData(), frame.size());
     m_socket->flush();
     
+    Metrics& metrics = Metrics::instance();
+    metrics.increment(Metrics::FramesSent);
+    metrics.increment(Metrics::BytesSent, frame.size());
+    
     return written == frame.size();
 }
 
-bool DiscordRPC::updatePresence(const QJsonObject& presence) {
-    if (!m_connected) {
-        qWarning() << "Not connected to Discord RPC";
+bool DiscordRPC::sendPresence(const QByteArray& activity, quint64 nonce) {
+    // Serialized into the writer's buffer, no payload or frame copies
+    if (!writeFrame(m_writer.writeSetActivityFrame(activity, m_pid, nonce))) {
         return false;
     }
     
-    QJsonObject args;
-    args["pid"] = QCoreApplication::applicationPid();
-    args["activity"] = presence;
+    // Forget commands Discord never answered
+    for (auto it = m_pendingCommands.begin(); it != m_pendingCommands.end();) {
+        if (it.value().sent.hasExpired(COMMAND_TIMEOUT_MS)) {
+            qCWarning(lcRpcFrames) << "Discord never answered" << it.value().cmd << "nonce" << it.key();
+            it = m_pendingCommands.erase(it);
+        } else {
+            ++it;
+        }
+    }
     
-    QJsonObject frame;
-    frame["cmd"] = "SET_ACTIVITY";
-    frame["args"] = args;
-    frame["nonce"] = QString::number(QDateTime::currentMSecsSinceEpoch());
+    // Erased entries are reused, so this stops allocating once the table
+    // has room for the commands in flight
+    PendingCommand& pending = m_pendingCommands[nonce];
+    pending.cmd = "SET_ACTIVITY";
+    pending.sent.start();
     
-    return sendFrame(OpCode::FRAME, frame);
+    return true;
 }
 
-bool DiscordRPC::clearPresence() {
-    if (!m_connected) {
-        return false;
+void DiscordRPC::completeCommand(quint64 nonce, const QJsonObject& response) {
+    auto it = m_pendingCommands.find(nonce);
+    if (it == m_pendingCommands.end()) {
+        return;
+    }
+    
+    PendingCommand pending = it.value();
+    m_pendingCommands.erase(it);
+    
+    QString cmd = QString::fromLatin1(pending.cmd);
+    emit commandCompleted(cmd, pending.sent.nsecsElapsed() / 1000);
+    
+    if (response.value("evt").toString() == "ERROR") {
+        QJsonObject data = response.value("data").toObject();
+        emit commandFailed(cmd, data.value("code").toInt(), data.value("message").toString());
+    }
+    
+    emit responseReceived(nonce, response);
+}
+
+quint64 DiscordRPC::updatePresence(const QByteArray& activity) {
+    if (!isConnected()) {
+        qCWarning(lcRpcIo) << "Not connected to Discord RPC";
+        return 0;
+    }
+    
+    // Unique per instance, unlike a millisecond timestamp
+    quint64 nonce = ++m_nonceCounter;
+    return sendPresence(activity, nonce) ? nonce : 0;
+}
+
+quint64 DiscordRPC::clearPresence() {
+    if (!isConnected()) {
+        return 0;
     }
     
-    QJsonObject args;
-    args["pid"] = QCoreApplication::applicationPid();
+    quint64 nonce = ++m_nonceCounter;
+    return sendPresence(QByteArray(), nonce) ? nonce : 0;
+}
+
+quint64 DiscordRPC::postPresence(const QByteArray& activity) {
+    // Only a reference to the activity crosses threads, the I/O thread
+    // serializes the frame
+    PostedCommand command;
+    command.nonce = ++m_nonceCounter;
+    command.activity = activity;
     
-    QJsonObject frame;
-    frame["cmd"] = "SET_ACTIVITY";
-    frame["args"] = args;
-    frame["nonce"] = QString::number(QDateTime::currentMSecsSinceEpoch());
+    quint64 nonce = command.nonce;
+    if (!m_outbox.tryPush(std::move(command))) {
+        qCWarning(lcRpcIo) << "Discord RPC outbox full, dropping presence";
+        return 0;
+    }
     
-    return sendFrame(OpCode::FRAME, frame);
+    // One wake-up covers everything pushed until the drain starts
+    if (!m_drainScheduled.exchange(true)) {
+        QMetaObject::invokeMethod(this, &DiscordRPC::drainOutbox, Qt::QueuedConnection);
+    }
+    return nonce;
+}
+
+void DiscordRPC::drainOutbox() {
+    m_drainScheduled.store(false);
+    
+    PostedCommand command;
+    while (m_outbox.tryPop(command)) {
+        if (!isConnected() || !sendPresence(command.activity, command.nonce)) {
+            emit commandDropped(command.nonce);
+        }
+    }
+    // Don't hold on to the last presence until the slot is reused
+    command.activity = QByteArray();
 }
 
 void DiscordRPC::onSocketConnected() {
-    qDebug() << "Socket connected";
+    if (m_state != State::Probing) {
+        return;
+    }
+    
+    m_timeoutTimer->stop();
+    qCDebug(lcRpcIo) << "Connected to Discord IPC:" << m_socket->serverName();
+    sendHandshake();
 }
 
 void DiscordRPC::onSocketDisconnected() {
-    qDebug() << "Socket disconnected";
-    m_connected = false;
-    emit disconnected();
+    qCDebug(lcRpcIo) << "Socket disconnected";
+    
+    if (m_state == State::Handshaking) {
+        failAttempt("Discord closed the connection during handshake");
+    } else if (m_state == State::Ready) {
+        dropConnection();
+    }
 }
 
 void DiscordRPC::onSocketError(QLocalSocket::LocalSocketError socketError) {
+    if (m_state == State::Probing) {
+        // Nothing listening on this pipe
+        failAttempt(QString("Discord is not listening on %1").arg(m_endpoint));
+        return;
+    }
+    
     QString errorStr = m_socket ? m_socket->errorString() : "Unknown error";
-    qWarning() << "Socket error:" << socketError << errorStr;
+    qCWarning(lcRpcIo) << "Socket error:" << socketError << errorStr;
+}
+
+void DiscordRPC::onTimeout() {
+    if (m_state == State::Probing) {
+        failAttempt(QString("Timed out connecting to Discord IPC: %1").arg(m_endpoint));
+    } else if (m_state == State::Handshaking) {
+        failAttempt("Timed out waiting for Discord handshake");
+    }
 }
 
 void DiscordRPC::onReadyRead() {
     if (!m_socket) return;
     
-    m_readBuffer.append(m_socket->readAll());
+    qint64 received = m_reader.readFrom(m_socket);
+    if (received > 0) {
+        Metrics::instance().increment(Metrics::BytesReceived, received);
+    }
     processFrames();
 }
 
 void DiscordRPC::processFrames() {
-    while (m_readBuffer.size() >= 8) {
-        // Read header
-        QDataStream stream(m_readBuffer);
-        stream.setByteOrder(QDataStream::LittleEndian);
-        
-        qint32 opcode, length;
-        stream >> opcode >> length;
-        
-        // Check if we have the complete frame
-        if (m_readBuffer.size() < 8 + length) {
-            return; // Wait for more data
-        }
-        
-        // Extract the payload
-        QByteArray payload = m_readBuffer.mid(8, length);
+    FrameReader::Frame frame;
+    FrameReader::Result result;
+    
+    while ((result = m_reader.next(frame)) == FrameReader::Result::Frame) {
+        Metrics::instance().increment(Metrics::FramesReceived);
         
-        // Remove processed frame from buffer
-        m_readBuffer.remove(0, 8 + length);
+        // Payload is parsed straight out of the read buffer
+        QByteArray payload = frame.payloadView();
+        qCDebug(lcRpcFrames).noquote() << "Received frame" << frame.opcode << payload;
         
         // Process the frame
-        if (opcode == OpCode::FRAME) {
+        if (frame.opcode == OpCode::FRAME) {
             QJsonDocument doc = QJsonDocument::fromJson(payload);
             if (!doc.isNull() && doc.isObject()) {
                 QJsonObject response = doc.object();
                 QString cmd = response["cmd"].toString();
                 
-                qDebug() << "Received Discord RPC response:" << cmd;
+                qCDebug(lcRpcFrames) << "Received Discord RPC response:" << cmd;
+                
+                // Answers to our own commands carry the nonce we sent
+                quint64 nonce = response["nonce"].toString().toULongLong();
+                if (nonce != 0) {
+                    completeCommand(nonce, response);
+                }
                 
                 // Handle READY response from handshake
                 if (cmd == "DISPATCH") {
                     QString evt = response["evt"].toString();
-                    if (evt == "READY" && !m_connected) {
-                        m_connected = true;
-                        qDebug() << "Discord RPC handshake complete";
+                    if (evt == "READY" && m_state == State::Handshaking) {
+                        m_timeoutTimer->stop();
+                        m_state = State::Ready;
+                        Metrics& metrics = Metrics::instance();
+                        metrics.increment(Metrics::Connects);
+                        metrics.observe(Metrics::HandshakeDuration, m_handshakeTimer.nsecsElapsed() / 1000);
+                        qCDebug(lcRpcIo) << "Discord RPC handshake complete";
                         emit connected();
                     }
                 }
             }
-        } else if (opcode == OpCode::CLOSE) {
-            qDebug() << "Discord closed connection";
-            m_connected = false;
-            emit disconnected();
-        } else if (opcode == OpCode::PING) {
+        } else if (frame.opcode == OpCode::CLOSE) {
+            qCDebug(lcRpcIo) << "Discord closed connection";
+            if (m_state == State::Handshaking) {
+                QJsonObject reason = QJsonDocument::fromJson(payload).object();
+                failAttempt(QString("Discord rejected handshake: %1").arg(reason.value("message").toString()));
+            } else if (m_state == State::Ready) {
+                dropConnection();
+            }
+            return;
+        } else if (frame.opcode == OpCode::PING) {
             // Respond to ping with pong
             sendFrame(OpCode::PONG, QJsonObject());
         }
     }
+    
+    if (result == FrameReader::Result::Oversized) {
+        qCWarning(lcRpcFrames) << "Discord sent a frame larger than" << m_reader.maxFrameSize() << "bytes, dropping connection";
+        if (m_state == State::Ready) {
+            dropConnection();
+        } else {
+            failAttempt("Received an invalid frame from Discord");
+        }
+    }
 }
 
 } // namespace DiscordDrawRPC
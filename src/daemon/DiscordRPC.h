@@ -2,50 +2,125 @@
 
 #include <QObject>
 #include <QLocalSocket>
+#include <QTimer>
 #include <QString>
 #include <QJsonObject>
+#include <QByteArray>
+#include <QHash>
+#include <QElapsedTimer>
+#include <atomic>
+#include "FrameReader.h"
+#include "PresenceWriter.h"
+#include "SpscQueue.h"
 
 namespace DiscordDrawRPC {
 
 /**
  * Discord RPC client implementation
  * Communicates with Discord via IPC (named pipes on Windows, Unix sockets on Linux/Mac)
+ * 
+ * Each instance talks to a single discord-ipc-N endpoint, i.e. to one
+ * Discord client. Connecting never blocks: connect() starts the attempt and
+ * the outcome is reported through connected() or error().
+ * 
+ * The object may live on an I/O thread of its own. Another thread then
+ * invokes connect()/disconnect() through queued calls and hands presences
+ * over with postPresence(), while every signal arrives queued.
  */
 class DiscordRPC : public QObject {
     Q_OBJECT
     
 public:
-    explicit DiscordRPC(const QString& clientId, QObject* parent = nullptr);
+    enum class State {
+        Idle,           // Not connected, no attempt in progress
+        Probing,        // Waiting for the endpoint to accept the connection
+        Handshaking,    // Handshake sent, waiting for READY
+        Ready           // READY received, commands can be sent
+    };
+    
+    DiscordRPC(const QString& clientId, const QString& endpoint, QObject* parent = nullptr);
     ~DiscordRPC();
     
-    bool connect();
+    void connect();
     void disconnect();
-    bool isConnected() const { return m_connected; }
+    // Safe to read from any thread, a snapshot when called from another one
+    State state() const { return m_state; }
+    bool isConnected() const { return m_state == State::Ready; }
+    const QString& endpoint() const { return m_endpoint; }
+    
+    void setMaxFrameSize(qint32 maxFrameSize) { m_reader.setMaxFrameSize(maxFrameSize); }
+    
+    // Return the nonce of the sent command, or 0 if nothing was sent.
+    // The activity is compact JSON and is spliced into the frame as is;
+    // once the buffers have grown to fit, sending allocates nothing.
+    quint64 updatePresence(const QByteArray& activity);
+    quint64 clearPresence();
     
-    bool updatePresence(const QJsonObject& presence);
-    bool clearPresence();
+    // Queue a SET_ACTIVITY (a clear for an empty activity) for this object's
+    // thread; may be called from one other thread. Returns the nonce the
+    // response will carry, or 0 if the queue is full. Commands that can't
+    // be written once dequeued are reported by commandDropped().
+    quint64 postPresence(const QByteArray& activity);
     
 signals:
     void connected();
     void disconnected();
     void error(const QString& message);
+    void responseReceived(quint64 nonce, const QJsonObject& response);
+    // Round trip of a command, from write to Discord's matching response
+    void commandCompleted(const QString& cmd, qint64 latencyMicros);
+    // Discord answered a command with an ERROR event
+    void commandFailed(const QString& cmd, int code, const QString& message);
+    // A posted command was not sent, the connection wasn't ready
+    void commandDropped(quint64 nonce);
     
 private slots:
     void onSocketConnected();
     void onSocketDisconnected();
     void onSocketError(QLocalSocket::LocalSocketError socketError);
     void onReadyRead();
+    void onTimeout();
     
 private:
-    QString getDiscordIpcPath(int pipeNum = 0);
-    bool handshake();
+    void failAttempt(const QString& message);
+    void dropConnection();
+    void resetSocket(bool abort);
+    void sendHandshake();
+    bool sendPresence(const QByteArray& activity, quint64 nonce);
+    void drainOutbox();
+    void completeCommand(quint64 nonce, const QJsonObject& response);
     bool sendFrame(int opcode, const QJsonObject& data);
+    bool sendFrame(int opcode, const QByteArray& payload);
+    // Write a frame that already carries its header
+    bool writeFrame(const QByteArray& frame);
     void processFrames();
     
     QString m_clientId;
+    QString m_endpoint;
     QLocalSocket* m_socket;
-    bool m_connected;
-    QByteArray m_readBuffer;
+    qint64 m_pid;
+    std::atomic<State> m_state;
+    std::atomic<quint64> m_nonceCounter;
+    
+    // Presences posted from another thread, sharing the caller's activity
+    struct PostedCommand {
+        quint64 nonce = 0;
+        QByteArray activity;
+    };
+    static constexpr size_t OUTBOX_CAPACITY = 64;
+    SpscQueue<PostedCommand, OUTBOX_CAPACITY> m_outbox;
+    std::atomic<bool> m_drainScheduled;
+    
+    struct PendingCommand {
+        // A literal, so tracking a command copies no string
+        const char* cmd = nullptr;
+        QElapsedTimer sent;
+    };
+    QHash<quint64, PendingCommand> m_pendingCommands;
+    QElapsedTimer m_handshakeTimer;
+    QTimer* m_timeoutTimer;
+    FrameReader m_reader;
+    PresenceWriter m_writer;
 };
 
 } // namespace DiscordDrawRPC
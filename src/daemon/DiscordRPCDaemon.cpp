@@ -1,108 +1,194 @@
 #include "DiscordRPCDaemon.h"
+#include "LogCategories.h"
+#include "Metrics.h"
+#include "ServiceNotify.h"
+#include "SocketActivation.h"
+#include "StartupMarkers.h"
 #include "../common/Config.h"
-#include "../common/PlatformUtils.h"
+#include "../common/DaemonIPC.h"
 #include <QCoreApplication>
 #include <QFile>
-#include <QJsonDocument>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QDebug>
-#include <QThread>
 
 namespace DiscordDrawRPC {
 
+// How often the event loop is sampled for lag
+static constexpr int LAG_SAMPLE_INTERVAL_MS = 1000;
+// How often --metrics-file is rewritten
+static constexpr int METRICS_DUMP_INTERVAL_MS = 15000;
+// Folds the events of one atomic state file replacement together
+static constexpr int STATE_SETTLE_DELAY_MS = 50;
+
 DiscordRPCDaemon::DiscordRPCDaemon(QObject* parent)
     : QObject(parent)
-    , m_rpc(nullptr)
+    , m_maxFrameSize(0)
     , m_watcher(nullptr)
-    , m_reconnectTimer(nullptr)
+    , m_controlServer(nullptr)
+    , m_discovery(nullptr)
+    , m_ioThread(nullptr)
     , m_running(false)
+    , m_lastSeq(0)
+    , m_stateSettleTimer(nullptr)
+    , m_idleTimer(nullptr)
+    , m_lagTimer(nullptr)
+    , m_metricsTimer(nullptr)
 {
 }
 
 DiscordRPCDaemon::~DiscordRPCDaemon() {
     stop();
+    
+    // Sessions hand their RPC to the I/O thread for deletion, which it does
+    // on its way out, so they have to go first (stop() only schedules it)
+    qDeleteAll(findChildren<DiscordSession*>(QString(), Qt::FindDirectChildrenOnly));
+    m_sessions.clear();
+    if (m_ioThread) {
+        m_ioThread->quit();
+        m_ioThread->wait();
+    }
 }
 
 void DiscordRPCDaemon::start() {
+    // Loaded by main(), the watcher keeps it current from here on
     Config& config = Config::instance();
-    config.load();
     
-    QString clientId = config.getValue("discord_client_id");
+    const QString& clientId = config.discordClientId();
     if (clientId.isEmpty()) {
-        qCritical() << "Error: discord_client_id is empty in config file";
-        qCritical() << "Please set discord_client_id in the config file";
+        qCCritical(lcDaemonLifecycle) << "Error: discord_client_id is empty in config file";
+        qCCritical(lcDaemonLifecycle) << "Please set discord_client_id in the config file";
         QCoreApplication::exit(1);
         return;
     }
     
     m_running = true;
+    m_clientId = clientId;
+    m_maxFrameSize = config.maxFrameSize();
+    connect(&config, &Config::changed, this, &DiscordRPCDaemon::onConfigChanged);
     
-    // Write PID file
-    writePidFile();
-    
-    qInfo() << "Discord RPC Daemon started";
-    qInfo() << "PID:" << QCoreApplication::applicationPid();
-    qInfo() << "State file:" << config.getStateFilePath();
+    qCInfo(lcDaemonLifecycle) << "Discord RPC Daemon started";
+    qCInfo(lcDaemonLifecycle) << "PID:" << QCoreApplication::applicationPid();
+    qCInfo(lcDaemonLifecycle) << "State file:" << config.getStateFilePath();
     
-    // Initialize Discord RPC
-    m_rpc = new DiscordRPC(clientId, this);
+    // A timer that fires late means something blocked the event loop
+    m_lagTimer = new QTimer(this);
+    m_lagTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_lagTimer, &QTimer::timeout, this, &DiscordRPCDaemon::onLagTimer);
+    m_lagClock.start();
+    m_lagTimer->start(LAG_SAMPLE_INTERVAL_MS);
     
-    // Try to connect
-    if (m_rpc->connect()) {
-        qInfo() << "Connected to Discord RPC";
-    } else {
-        qWarning() << "Failed to connect to Discord initially, will retry";
+    if (!m_metricsFile.isEmpty()) {
+        qCInfo(lcDaemonLifecycle) << "Metrics file:" << m_metricsFile;
+        m_metricsTimer = new QTimer(this);
+        connect(m_metricsTimer, &QTimer::timeout, this, &DiscordRPCDaemon::writeMetricsFile);
+        m_metricsTimer->start(METRICS_DUMP_INTERVAL_MS);
     }
     
-    // Setup reconnect timer
-    m_reconnectTimer = new QTimer(this);
-    connect(m_reconnectTimer, &QTimer::timeout, this, &DiscordRPCDaemon::onReconnectTimer);
-    m_reconnectTimer->start(5000); // Try to reconnect every 5 seconds if disconnected
+    // Discord sockets and frame codecs run on their own thread, so file
+    // watchers, timers and control clients on this one never delay them
+    m_ioThread = new QThread(this);
+    m_ioThread->setObjectName("discord-io");
+    m_ioThread->start();
+    
+    // Discovery reports new Discord sockets so we don't have to poll for them,
+    // it keeps watching so clients started later get a session too
+    m_discovery = new IpcDiscovery(this);
+    connect(m_discovery, &IpcDiscovery::socketAppeared, this, &DiscordRPCDaemon::onEndpointsChanged);
+    m_discovery->watch();
+    
+    // Connect to every Discord client already running
+    onEndpointsChanged();
+    markStartup("sessions_started");
+    
+    // Setup file watcher on the state file's directory: the file is replaced
+    // on every write, which a watch on the file itself would not survive
+    m_stateSettleTimer = new QTimer(this);
+    m_stateSettleTimer->setSingleShot(true);
+    connect(m_stateSettleTimer, &QTimer::timeout, this, &DiscordRPCDaemon::onStateFileChanged);
     
-    // Setup file watcher
     m_watcher = new QFileSystemWatcher(this);
-    QString stateFile = config.getStateFilePath();
-    
-    // Make sure the state file exists
-    if (!QFile::exists(stateFile)) {
-        QFile file(stateFile);
-        if (file.open(QIODevice::WriteOnly)) {
-            file.write("{}");
-            file.close();
+    m_watcher->addPath(QFileInfo(config.getStateFilePath()).absolutePath());
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        if (!m_stateSettleTimer->isActive()) {
+            m_stateSettleTimer->start(STATE_SETTLE_DELAY_MS);
         }
-    }
+    });
+    
+    qCInfo(lcDaemonState) << "File watcher started";
     
-    m_watcher->addPath(stateFile);
-    connect(m_watcher, &QFileSystemWatcher::fileChanged, 
-            this, &DiscordRPCDaemon::onStateFileChanged);
+    // Setup control socket
+    m_controlServer = new ControlServer(this);
+    m_controlServer->setRequestHandler([this](const QJsonObject& request) {
+        return handleRequest(request);
+    });
+    qintptr activatedSocket = takeActivatedSocket();
+    if (activatedSocket >= 0) {
+        m_controlServer->listen(activatedSocket);
+    } else {
+        m_controlServer->listen(config.getControlSocketPath());
+    }
+    markStartup("control_listening");
     
-    qInfo() << "File watcher started";
+    // Socket activated, we can leave while idle and be started again on demand
+    m_idleTimer = new QTimer(this);
+    m_idleTimer->setSingleShot(true);
+    connect(m_idleTimer, &QTimer::timeout, this, &DiscordRPCDaemon::onIdleTimeout);
     
-    // Read and apply initial state
+    // Read and apply initial state (a persisted quit must not stop us right away)
     QJsonObject initialState = readStateFile();
-    if (!initialState.isEmpty()) {
+    m_lastSeq = initialState.value("seq").toInteger();
+    initialState.remove("seq");
+    if (!initialState.isEmpty() && initialState.value("command").toString() != "quit") {
         m_lastState = initialState;
         handleCommand(initialState);
-        qInfo() << "Applied initial state from file";
+        qCInfo(lcDaemonState) << "Applied initial state from file";
     }
+    markStartup("initial_state_applied");
+    
+    publishStatus("started");
+    updateIdleTimer();
+    
+    // Whoever launched us waits for this rather than polling for the socket
+    notifyService(NOTIFY_READY);
 }
 
 void DiscordRPCDaemon::stop() {
     if (!m_running) return;
     
     m_running = false;
+    publishStatus("stopping");
+    
+    for (DiscordSession* session : m_sessions) {
+        session->disconnect();
+        session->deleteLater();
+    }
+    m_sessions.clear();
     
-    if (m_rpc) {
-        m_rpc->disconnect();
-        m_rpc->deleteLater();
-        m_rpc = nullptr;
+    if (m_lagTimer) {
+        m_lagTimer->stop();
+        m_lagTimer->deleteLater();
+        m_lagTimer = nullptr;
     }
     
-    if (m_reconnectTimer) {
-        m_reconnectTimer->stop();
-        m_reconnectTimer->deleteLater();
-        m_reconnectTimer = nullptr;
+    if (m_idleTimer) {
+        m_idleTimer->stop();
+    }
+    
+    if (m_metricsTimer) {
+        m_metricsTimer->stop();
+        m_metricsTimer->deleteLater();
+        m_metricsTimer = nullptr;
+    }
+    // Leave the final numbers behind for the scraper
+    writeMetricsFile();
+    
+    if (m_discovery) {
+        m_discovery->stopWatching();
+        m_discovery->deleteLater();
+        m_discovery = nullptr;
     }
     
     if (m_watcher) {
@@ -110,17 +196,32 @@ void DiscordRPCDaemon::stop() {
         m_watcher = nullptr;
     }
     
-    removePidFile();
+    if (m_controlServer) {
+        m_controlServer->close();
+        m_controlServer->deleteLater();
+        m_controlServer = nullptr;
+    }
     
-    qInfo() << "Daemon stopped";
+    qCInfo(lcDaemonLifecycle) << "Daemon stopped";
+}
+
+void DiscordRPCDaemon::quit() {
+    // Through stop(), so subscribers hear of it and the last metrics are written
+    stop();
+    QCoreApplication::quit();
 }
 
 void DiscordRPCDaemon::onStateFileChanged() {
     QJsonObject newState = readStateFile();
     
-    if (newState.isEmpty()) {
+    // Only snapshots newer than the last one count, which also skips our
+    // own writes and repeated notifications for the same replacement
+    qint64 seq = newState.value("seq").toInteger();
+    if (seq <= m_lastSeq) {
         return;
     }
+    m_lastSeq = seq;
+    newState.remove("seq");
     
     // Check if state actually changed
     if (newState == m_lastState) {
@@ -129,129 +230,321 @@ void DiscordRPCDaemon::onStateFileChanged() {
     
     m_lastState = newState;
     handleCommand(newState);
+}
+
+void DiscordRPCDaemon::onConfigChanged() {
+    if (!m_running) return;
+    
+    Config& config = Config::instance();
+    applyLogLevels(config.logLevels());
+    updateIdleTimer();
+    
+    // Applies to the next frame each session reads
+    if (config.maxFrameSize() != m_maxFrameSize) {
+        m_maxFrameSize = config.maxFrameSize();
+        if (m_maxFrameSize > 0) {
+            for (DiscordSession* session : m_sessions) {
+                session->setMaxFrameSize(m_maxFrameSize);
+            }
+        }
+    }
+    
+    const QString& clientId = config.discordClientId();
+    if (clientId.isEmpty() || clientId == m_clientId) {
+        return;
+    }
     
-    // Re-add the file to the watcher (it might have been removed on some systems)
-    QString stateFile = Config::instance().getStateFilePath();
-    if (!m_watcher->files().contains(stateFile)) {
-        m_watcher->addPath(stateFile);
+    // The application is bound at the handshake, every session starts over
+    // and restores the current presence once connected
+    qCInfo(lcDaemonLifecycle) << "Discord client ID changed, reconnecting";
+    m_clientId = clientId;
+    const QList<DiscordSession*> sessions = m_sessions;
+    for (DiscordSession* session : sessions) {
+        removeSession(session);
     }
+    publishStatus("discord_disconnected");
+    onEndpointsChanged();
 }
 
-void DiscordRPCDaemon::onReconnectTimer() {
-    if (!m_rpc->isConnected()) {
-        qDebug() << "Attempting to reconnect to Discord...";
-        m_rpc->connect();
+void DiscordRPCDaemon::onEndpointsChanged() {
+    const QStringList endpoints = m_discovery->endpoints();
+    for (const QString& endpoint : endpoints) {
+        DiscordSession* session = findSession(endpoint);
+        if (!session) {
+            addSession(endpoint);
+        } else if (session->rpc()->state() == DiscordRPC::State::Idle) {
+            // The socket was recreated, Discord probably restarted
+            session->connectNow();
+        }
+    }
+    
+    if (m_sessions.isEmpty()) {
+        qCWarning(lcDaemonLifecycle) << "No Discord client found, waiting for one to start";
     }
 }
 
-QJsonObject DiscordRPCDaemon::readStateFile() {
-    QString stateFile = Config::instance().getStateFilePath();
+void DiscordRPCDaemon::addSession(const QString& endpoint) {
+    qCDebug(lcDaemonLifecycle) << "Opening Discord session on" << endpoint;
     
-    QFile file(stateFile);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return QJsonObject();
+    DiscordSession* session = new DiscordSession(m_clientId, endpoint, m_ioThread, this);
+    if (m_maxFrameSize > 0) {
+        session->setMaxFrameSize(m_maxFrameSize);
     }
+    m_sessions.append(session);
     
-    QByteArray data = file.readAll();
-    file.close();
+    connect(session, &DiscordSession::connected, this, [this, session]() {
+        onSessionConnected(session);
+    });
+    connect(session, &DiscordSession::failed, this, [this, session]() {
+        onSessionFailed(session);
+    });
+    connect(session, &DiscordSession::disconnected, this, [this]() {
+        publishStatus("discord_disconnected");
+    });
+    connect(session, &DiscordSession::presenceApplied, this, [this]() {
+        publishStatus("presence_applied");
+    });
+    connect(session->rpc(), &DiscordRPC::commandCompleted, this, &DiscordRPCDaemon::onCommandCompleted);
+    connect(session->rpc(), &DiscordRPC::commandFailed, this, &DiscordRPCDaemon::onCommandFailed);
     
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (doc.isNull() || !doc.isObject()) {
-        return QJsonObject();
+    // Start from the current presence, it goes out once the handshake is done
+    if (!m_activity.isEmpty() && m_lastState.value("command").toString() == "update") {
+        session->submitUpdate(m_activity);
     }
     
-    return doc.object();
+    session->connectNow();
 }
 
-void DiscordRPCDaemon::handleCommand(const QJsonObject& stateData) {
-    QString command = stateData.value("command").toString();
+void DiscordRPCDaemon::removeSession(DiscordSession* session) {
+    qCDebug(lcDaemonLifecycle) << "Closing Discord session on" << session->endpoint();
     
-    if (command == "clear") {
-        qInfo() << "Clearing presence";
-        if (m_rpc->isConnected()) {
-            m_rpc->clearPresence();
-        }
-    } else if (command == "update") {
-        qInfo() << "Updating presence";
-        
-        if (!m_rpc->isConnected()) {
-            qWarning() << "Not connected to Discord, attempting to connect...";
-            if (!m_rpc->connect()) {
-                qWarning() << "Failed to connect to Discord";
-                return;
-            }
+    m_sessions.removeOne(session);
+    session->disconnect();
+    // May be inside one of the session's own signals
+    session->deleteLater();
+}
+
+DiscordSession* DiscordRPCDaemon::findSession(const QString& endpoint) const {
+    for (DiscordSession* session : m_sessions) {
+        if (session->endpoint() == endpoint) {
+            return session;
         }
-        
-        // Build presence object
-        QJsonObject presence;
-        
-        QString state = stateData.value("state").toString();
-        QString details = stateData.value("details").toString();
-        
-        if (!state.isEmpty()) {
-            presence["state"] = state;
+    }
+    return nullptr;
+}
+
+void DiscordRPCDaemon::onSessionFailed(DiscordSession* session) {
+    // The client is gone for good, discovery brings it back if it returns
+    if (!IpcDiscovery::exists(session->endpoint())) {
+        m_discovery->forget(session->endpoint());
+        removeSession(session);
+        if (m_sessions.isEmpty()) {
+            qCWarning(lcDaemonLifecycle) << "Lost every Discord client, waiting for one to start";
         }
-        if (!details.isEmpty()) {
-            presence["details"] = details;
+    }
+}
+
+void DiscordRPCDaemon::onCommandCompleted(const QString& cmd, qint64 latencyMicros) {
+    Metrics::instance().observeCommand(cmd, latencyMicros);
+}
+
+void DiscordRPCDaemon::onLagTimer() {
+    qint64 elapsed = m_lagClock.nsecsElapsed() / 1000;
+    m_lagClock.restart();
+    Metrics::instance().observe(Metrics::EventLoopLag,
+                                qMax<qint64>(0, elapsed - qint64(LAG_SAMPLE_INTERVAL_MS) * 1000));
+}
+
+void DiscordRPCDaemon::writeMetricsFile() {
+    if (m_metricsFile.isEmpty()) {
+        return;
+    }
+    
+    // Replaced atomically so a scraper never reads half a file
+    QSaveFile file(m_metricsFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcDaemonLifecycle) << "Failed to open metrics file for writing:" << m_metricsFile;
+        return;
+    }
+    file.write(Metrics::instance().toPrometheus());
+    if (!file.commit()) {
+        qCWarning(lcDaemonLifecycle) << "Failed to write metrics file:" << m_metricsFile;
+    }
+}
+
+void DiscordRPCDaemon::onCommandFailed(const QString& cmd, int code, const QString& message) {
+    qCWarning(lcRpcFrames) << "Discord rejected" << cmd << "with code" << code << ":" << message;
+}
+
+void DiscordRPCDaemon::onSessionConnected(DiscordSession* session) {
+    m_discovery->remember(session->endpoint());
+    markStartup("discord_ready");
+    publishStatus("discord_connected");
+    
+    // Discord drops our activity with the connection, restore it unless
+    // the queue is about to send a newer one anyway
+    if (!session->queue()->hasPending() && !m_activity.isEmpty()
+        && m_lastState.value("command").toString() == "update") {
+        session->submitUpdate(m_activity);
+    }
+}
+
+QJsonObject DiscordRPCDaemon::readStateFile() {
+    Metrics::instance().increment(Metrics::StateReads);
+    return DaemonIPC::readStateSnapshot();
+}
+
+bool DiscordRPCDaemon::isPresenceActive() const {
+    return !m_activity.isEmpty() && m_lastState.value("command").toString() == "update";
+}
+
+void DiscordRPCDaemon::updateIdleTimer() {
+    if (!m_idleTimer) {
+        return;
+    }
+    
+    // Without an activator nothing would start us again
+    int seconds = Config::instance().idleExitSeconds();
+    if (!m_running || seconds <= 0 || !m_controlServer->isActivated() || isPresenceActive()) {
+        m_idleTimer->stop();
+        return;
+    }
+    
+    // Any request starts the wait over
+    m_idleTimer->start(seconds * 1000);
+}
+
+void DiscordRPCDaemon::onIdleTimeout() {
+    // A client in the middle of a request isn't idle, subscribers only listen
+    if (m_controlServer->clientCount() > m_controlServer->subscriberCount()) {
+        updateIdleTimer();
+        return;
+    }
+    
+    qCInfo(lcDaemonLifecycle) << "No presence for" << Config::instance().idleExitSeconds()
+                              << "seconds, exiting until the next client";
+    quit();
+}
+
+QJsonObject DiscordRPCDaemon::statusJson() const {
+    int connected = 0;
+    for (DiscordSession* session : m_sessions) {
+        if (session->isConnected()) {
+            connected++;
         }
+    }
+    
+    bool presenceActive = isPresenceActive();
+    
+    QJsonObject status;
+    status["running"] = m_running;
+    status["discord_connected"] = connected > 0;
+    status["discord_clients"] = connected;
+    status["presence_active"] = presenceActive;
+    status["details"] = presenceActive ? m_lastState.value("details").toString() : QString();
+    return status;
+}
+
+void DiscordRPCDaemon::publishStatus(const QString& event) {
+    if (!m_controlServer || m_controlServer->subscriberCount() == 0) {
+        return;
+    }
+    
+    QJsonObject message;
+    message["event"] = event;
+    message["status"] = statusJson();
+    m_controlServer->publish(message);
+}
+
+QJsonObject DiscordRPCDaemon::handleRequest(const QJsonObject& request) {
+    QString op = request.value("op").toString();
+    QJsonObject response;
+    response["ok"] = true;
+    
+    if (op == "update") {
+        QJsonObject newState = request.value("state").toObject();
+        newState["command"] = "update";
         
-        // Add timestamps
-        QJsonObject timestamps;
-        qint64 startTime = stateData.value("start").toVariant().toLongLong();
-        if (startTime > 0) {
-            timestamps["start"] = startTime;
+        if (newState != m_lastState) {
+            m_lastState = newState;
+            handleCommand(newState);
+            DaemonIPC::writeStateSnapshot(newState, &m_lastSeq);
         }
-        if (!timestamps.isEmpty()) {
-            presence["timestamps"] = timestamps;
+        response["state"] = m_lastState;
+    } else if (op == "clear") {
+        // Keep the fields around so the GUI can still show the last status
+        m_lastState["command"] = "clear";
+        handleCommand(m_lastState);
+        DaemonIPC::writeStateSnapshot(m_lastState, &m_lastSeq);
+        response["state"] = m_lastState;
+    } else if (op == "quit") {
+        qCInfo(lcDaemonLifecycle) << "Received quit request";
+        // Let the acknowledgement go out before the control socket closes
+        QTimer::singleShot(0, this, &DiscordRPCDaemon::quit);
+    } else if (op == "get_state") {
+        response["state"] = m_lastState;
+    } else if (op == "subscribe") {
+        // The control server keeps sending events to this client from now on
+        response["status"] = statusJson();
+    } else if (op == "stats") {
+        QJsonObject stats;
+        qint64 suppressed = 0;
+        qint64 coalesced = 0;
+        QJsonArray sessions;
+        for (DiscordSession* session : m_sessions) {
+            suppressed += static_cast<qint64>(session->queue()->suppressedCount());
+            coalesced += static_cast<qint64>(session->queue()->coalescedCount());
+            sessions.append(session->stats());
         }
+        stats["suppressed_updates"] = suppressed;
+        stats["coalesced_updates"] = coalesced;
+        stats["sessions"] = sessions;
         
-        // Add assets (images)
-        QJsonObject assets;
-        QString largeImage = stateData.value("large_image").toString();
-        QString largeText = stateData.value("large_text").toString();
-        QString smallImage = stateData.value("small_image").toString();
-        QString smallText = stateData.value("small_text").toString();
-        
-        if (!largeImage.isEmpty()) {
-            assets["large_image"] = largeImage;
-            if (!largeText.isEmpty()) {
-                assets["large_text"] = largeText;
-            }
-        }
-        if (!smallImage.isEmpty()) {
-            assets["small_image"] = smallImage;
-            if (!smallText.isEmpty()) {
-                assets["small_text"] = smallText;
-            }
-        }
-        if (!assets.isEmpty()) {
-            presence["assets"] = assets;
+        Metrics& metrics = Metrics::instance();
+        stats["discord_latency"] = metrics.commandJson();
+        stats["queue_latency"] = metrics.summaryJson(Metrics::QueueWait);
+        response["stats"] = stats;
+    } else if (op == "metrics") {
+        response["metrics"] = QString::fromLatin1(Metrics::instance().toPrometheus());
+    } else {
+        response["ok"] = false;
+        response["error"] = QString("Unknown operation: %1").arg(op);
+    }
+    
+    updateIdleTimer();
+    return response;
+}
+
+void DiscordRPCDaemon::handleCommand(const QJsonObject& stateData) {
+    QString command = stateData.value("command").toString();
+    
+    if (command == "clear") {
+        qCInfo(lcDaemonState) << "Clearing presence";
+        m_activity.clear();
+        for (DiscordSession* session : m_sessions) {
+            session->submitClear();
         }
+    } else if (command == "update") {
+        qCInfo(lcDaemonState) << "Updating presence";
         
-        // Add buttons (if any)
-        QJsonArray buttons = stateData.value("buttons").toArray();
-        if (!buttons.isEmpty()) {
-            presence["buttons"] = buttons;
+        // Serialized once for every session, straight into the writer's
+        // reused buffer. Sessions hold on to m_activity, so it is only
+        // copied out when the presence actually changed.
+        const QByteArray& activity = m_presenceWriter.writeActivity(Presence::fromState(stateData));
+        if (activity != m_activity) {
+            m_activity = QByteArray(activity.constData(), activity.size());
+        }
+        qCDebug(lcDaemonState).noquote() << "Presence data:" << m_activity;
+        for (DiscordSession* session : m_sessions) {
+            session->submitUpdate(m_activity);
         }
-        
-        qDebug().noquote() << "Presence data:" << QJsonDocument(presence).toJson(QJsonDocument::Compact);
-        m_rpc->updatePresence(presence);
         
     } else if (command == "quit") {
-        qInfo() << "Received quit command";
-        m_running = false;
-        QCoreApplication::quit();
+        qCInfo(lcDaemonLifecycle) << "Received quit command";
+        quit();
     }
-}
-
-void DiscordRPCDaemon::writePidFile() {
-    QString pidFile = Config::instance().getDaemonPidFilePath();
-    ProcessUtils::writePidFile(pidFile, QCoreApplication::applicationPid());
-}
-
-void DiscordRPCDaemon::removePidFile() {
-    QString pidFile = Config::instance().getDaemonPidFilePath();
-    QFile::remove(pidFile);
+    
+    updateIdleTimer();
 }
 
 } // namespace DiscordDrawRPC
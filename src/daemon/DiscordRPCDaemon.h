@@ -1,9 +1,16 @@
 #pragma once
 
 #include <QObject>
+#include <QThread>
 #include <QFileSystemWatcher>
 #include <QTimer>
-#include "DiscordRPC.h"
+#include <QList>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include "DiscordSession.h"
+#include "IpcDiscovery.h"
+#include "ControlServer.h"
+#include "PresenceWriter.h"
 
 namespace DiscordDrawRPC {
 
@@ -14,24 +21,63 @@ public:
     explicit DiscordRPCDaemon(QObject* parent = nullptr);
     ~DiscordRPCDaemon();
     
+    // Periodically dump metrics in Prometheus text format to this file
+    void setMetricsFile(const QString& path) { m_metricsFile = path; }
+    
     void start();
     void stop();
+    // stop() and leave the event loop
+    void quit();
     
 private slots:
     void onStateFileChanged();
-    void onReconnectTimer();
+    void onConfigChanged();
+    void onEndpointsChanged();
+    void onSessionConnected(DiscordSession* session);
+    void onSessionFailed(DiscordSession* session);
+    void onLagTimer();
+    void onIdleTimeout();
+    void writeMetricsFile();
+    void onCommandCompleted(const QString& cmd, qint64 latencyMicros);
+    void onCommandFailed(const QString& cmd, int code, const QString& message);
     
 private:
     void handleCommand(const QJsonObject& stateData);
+    QJsonObject handleRequest(const QJsonObject& request);
     QJsonObject readStateFile();
-    void writePidFile();
-    void removePidFile();
+    bool isPresenceActive() const;
+    // Counts down to exiting while socket activated without a presence
+    void updateIdleTimer();
+    // What subscribers are told: running, Discord connection and presence
+    QJsonObject statusJson() const;
+    void publishStatus(const QString& event);
+    void addSession(const QString& endpoint);
+    void removeSession(DiscordSession* session);
+    DiscordSession* findSession(const QString& endpoint) const;
     
-    DiscordRPC* m_rpc;
+    // One session per Discord client that is running
+    QList<DiscordSession*> m_sessions;
+    QString m_clientId;
+    int m_maxFrameSize;
     QFileSystemWatcher* m_watcher;
-    QTimer* m_reconnectTimer;
+    ControlServer* m_controlServer;
+    IpcDiscovery* m_discovery;
+    // Where every session's DiscordRPC lives
+    QThread* m_ioThread;
     bool m_running;
     QJsonObject m_lastState;
+    // Sequence number of the last state snapshot acted on or written
+    qint64 m_lastSeq;
+    QTimer* m_stateSettleTimer;
+    QTimer* m_idleTimer;
+    // Activity serialized once and shared by every session, empty when cleared
+    QByteArray m_activity;
+    PresenceWriter m_presenceWriter;
+    
+    QTimer* m_lagTimer;
+    QElapsedTimer m_lagClock;
+    QTimer* m_metricsTimer;
+    QString m_metricsFile;
 };
 
 } // namespace DiscordDrawRPC
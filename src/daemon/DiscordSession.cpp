@@ -0,0 +1,98 @@
+#include "DiscordSession.h"
+#include "LogCategories.h"
+#include <QDebug>
+
+namespace DiscordDrawRPC {
+
+// Delays between connection attempts while this client isn't answering
+static constexpr int RECONNECT_INTERVAL_MS = 5000;
+static constexpr int MAX_RECONNECT_DELAY_MS = 60000;
+
+DiscordSession::DiscordSession(const QString& clientId, const QString& endpoint, QThread* ioThread, QObject* parent)
+    : QObject(parent)
+    , m_rpc(new DiscordRPC(clientId, endpoint))
+    , m_queue(nullptr)
+    , m_retryTimer(new QTimer(this))
+    , m_retryDelay(RECONNECT_INTERVAL_MS)
+{
+    // Moved before anything connects to it, its signals then arrive queued
+    if (ioThread) {
+        m_rpc->moveToThread(ioThread);
+    }
+    m_queue = new PresenceQueue(m_rpc, this);
+    
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, &DiscordSession::onRetryTimer);
+    
+    connect(m_rpc, &DiscordRPC::connected, this, &DiscordSession::onConnected);
+    connect(m_rpc, &DiscordRPC::disconnected, this, &DiscordSession::onDisconnected);
+    connect(m_rpc, &DiscordRPC::error, this, &DiscordSession::onError);
+    connect(m_queue, &PresenceQueue::applied, this, &DiscordSession::presenceApplied);
+}
+
+DiscordSession::~DiscordSession() {
+    // Deleted on its own thread, which disconnects it
+    m_rpc->deleteLater();
+}
+
+void DiscordSession::connectNow() {
+    m_retryTimer->stop();
+    m_retryDelay = RECONNECT_INTERVAL_MS;
+    
+    // Runs right away on the same thread, where it may fail synchronously:
+    // nothing may follow this call
+    QMetaObject::invokeMethod(m_rpc, &DiscordRPC::connect);
+}
+
+void DiscordSession::disconnect() {
+    m_retryTimer->stop();
+    QMetaObject::invokeMethod(m_rpc, &DiscordRPC::disconnect);
+}
+
+void DiscordSession::setMaxFrameSize(qint32 maxFrameSize) {
+    QMetaObject::invokeMethod(m_rpc, [rpc = m_rpc, maxFrameSize]() {
+        rpc->setMaxFrameSize(maxFrameSize);
+    });
+}
+
+QJsonObject DiscordSession::stats() const {
+    QJsonObject stats;
+    stats["endpoint"] = endpoint();
+    stats["connected"] = isConnected();
+    stats["suppressed_updates"] = static_cast<qint64>(m_queue->suppressedCount());
+    stats["coalesced_updates"] = static_cast<qint64>(m_queue->coalescedCount());
+    return stats;
+}
+
+void DiscordSession::onConnected() {
+    qCInfo(lcRpcIo) << "Connected to Discord RPC on" << endpoint();
+    
+    m_retryTimer->stop();
+    m_retryDelay = RECONNECT_INTERVAL_MS;
+    emit connected();
+}
+
+void DiscordSession::onDisconnected() {
+    qCInfo(lcRpcIo) << "Disconnected from Discord RPC on" << endpoint();
+    emit disconnected();
+    
+    // Discord may have just restarted, look for it right away
+    connectNow();
+}
+
+void DiscordSession::onError(const QString& message) {
+    qCDebug(lcRpcIo) << message;
+    
+    m_retryTimer->start(m_retryDelay);
+    m_retryDelay = qMin(m_retryDelay * 2, MAX_RECONNECT_DELAY_MS);
+    emit failed(message);
+}
+
+void DiscordSession::onRetryTimer() {
+    if (m_rpc->state() == DiscordRPC::State::Idle) {
+        qCDebug(lcRpcIo) << "Attempting to reconnect to Discord on" << endpoint();
+        QMetaObject::invokeMethod(m_rpc, &DiscordRPC::connect);
+    }
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include "DiscordRPC.h"
+#include "PresenceQueue.h"
+
+namespace DiscordDrawRPC {
+
+/**
+ * Connection to one Discord client.
+ * Bundles a DiscordRPC bound to a single discord-ipc-N endpoint with its own
+ * PresenceQueue and reconnect backoff, so a slow or missing client never
+ * holds back the others. The DiscordRPC, with its socket and frame codec,
+ * can run on a separate I/O thread; the session and its queue stay on the
+ * thread that created them.
+ */
+class DiscordSession : public QObject {
+    Q_OBJECT
+    
+public:
+    // Without an I/O thread the RPC runs on the caller's thread
+    DiscordSession(const QString& clientId, const QString& endpoint, QThread* ioThread = nullptr,
+                   QObject* parent = nullptr);
+    ~DiscordSession();
+    
+    const QString& endpoint() const { return m_rpc->endpoint(); }
+    DiscordRPC* rpc() const { return m_rpc; }
+    PresenceQueue* queue() const { return m_queue; }
+    bool isConnected() const { return m_rpc->isConnected(); }
+    
+    // Connect now unless already connected or connecting, resetting the backoff
+    void connectNow();
+    void disconnect();
+    void setMaxFrameSize(qint32 maxFrameSize);
+    
+    void submitUpdate(const QByteArray& activity) { m_queue->submitUpdate(activity); }
+    void submitClear() { m_queue->submitClear(); }
+    
+    // endpoint, connected, suppressed/coalesced updates
+    QJsonObject stats() const;
+    
+signals:
+    void connected();
+    void disconnected();
+    void presenceApplied();
+    // A connection attempt failed, a retry is already scheduled
+    void failed(const QString& message);
+    
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onError(const QString& message);
+    void onRetryTimer();
+    
+private:
+    DiscordRPC* m_rpc;
+    PresenceQueue* m_queue;
+    QTimer* m_retryTimer;
+    int m_retryDelay;
+};
+
+} // namespace DiscordDrawRPC
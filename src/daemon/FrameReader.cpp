@@ -0,0 +1,95 @@
+#include "FrameReader.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace DiscordDrawRPC {
+
+// Below this the consumed prefix is cheaper to keep than to move
+static constexpr qsizetype COMPACT_THRESHOLD = 4096;
+
+FrameReader::FrameReader()
+    : m_readPos(0)
+    , m_maxFrameSize(DEFAULT_MAX_FRAME_SIZE)
+{
+}
+
+void FrameReader::compact(qsizetype incoming) {
+    if (m_readPos == 0) {
+        return;
+    }
+    
+    qsizetype remaining = m_buffer.size() - m_readPos;
+    if (remaining == 0) {
+        // Everything consumed; resize keeps the allocation around
+        m_buffer.resize(0);
+        m_readPos = 0;
+        return;
+    }
+    
+    // Only move the tail when the dead prefix dominates and appending
+    // would otherwise have to grow the buffer
+    bool wouldGrow = m_buffer.size() + incoming > m_buffer.capacity();
+    if (m_readPos >= COMPACT_THRESHOLD && m_readPos >= remaining && wouldGrow) {
+        std::memmove(m_buffer.data(), m_buffer.constData() + m_readPos, remaining);
+        m_buffer.resize(remaining);
+        m_readPos = 0;
+    }
+}
+
+void FrameReader::append(const char* data, qsizetype size) {
+    if (size <= 0) {
+        return;
+    }
+    
+    compact(size);
+    m_buffer.append(data, size);
+}
+
+qint64 FrameReader::readFrom(QIODevice* device) {
+    qint64 available = device->bytesAvailable();
+    if (available <= 0) {
+        return 0;
+    }
+    
+    compact(available);
+    
+    qsizetype oldSize = m_buffer.size();
+    m_buffer.resize(oldSize + available);
+    qint64 got = device->read(m_buffer.data() + oldSize, available);
+    m_buffer.resize(oldSize + qMax<qint64>(got, 0));
+    
+    return got;
+}
+
+FrameReader::Result FrameReader::next(Frame& frame) {
+    qsizetype remaining = m_buffer.size() - m_readPos;
+    if (remaining < HEADER_SIZE) {
+        return Result::NeedMore;
+    }
+    
+    const char* header = m_buffer.constData() + m_readPos;
+    qint32 opcode = qFromLittleEndian<qint32>(header);
+    qint32 length = qFromLittleEndian<qint32>(header + 4);
+    
+    if (length < 0 || length > m_maxFrameSize) {
+        return Result::Oversized;
+    }
+    
+    if (remaining - HEADER_SIZE < length) {
+        return Result::NeedMore;
+    }
+    
+    frame.opcode = opcode;
+    frame.payload = header + HEADER_SIZE;
+    frame.length = length;
+    
+    m_readPos += HEADER_SIZE + length;
+    return Result::Frame;
+}
+
+void FrameReader::clear() {
+    m_buffer.resize(0);
+    m_readPos = 0;
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QIODevice>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Incremental decoder for Discord IPC frames:
+ * [opcode: int32 LE][length: int32 LE][payload: length bytes]
+ * 
+ * Bytes are appended to one reusable buffer and consumed through a read
+ * cursor. The consumed prefix is only compacted away once it makes up
+ * most of the buffer, so draining many small frames stays linear.
+ */
+class FrameReader {
+public:
+    static constexpr int HEADER_SIZE = 8;
+    static constexpr qint32 DEFAULT_MAX_FRAME_SIZE = 64 * 1024;
+    
+    enum class Result {
+        NeedMore,   // No complete frame buffered yet
+        Frame,      // A frame was decoded
+        Oversized   // Header announced an invalid or too large payload
+    };
+    
+    struct Frame {
+        qint32 opcode = 0;
+        // Points into the reader's buffer, valid until the next append
+        const char* payload = nullptr;
+        qint32 length = 0;
+        
+        QByteArray payloadView() const { return QByteArray::fromRawData(payload, length); }
+    };
+    
+    FrameReader();
+    
+    void setMaxFrameSize(qint32 maxFrameSize) { m_maxFrameSize = maxFrameSize; }
+    qint32 maxFrameSize() const { return m_maxFrameSize; }
+    
+    // Append raw bytes received from the socket
+    void append(const char* data, qsizetype size);
+    
+    // Append everything currently available on a device without an intermediate copy
+    qint64 readFrom(QIODevice* device);
+    
+    // Decode the next buffered frame
+    Result next(Frame& frame);
+    
+    qsizetype buffered() const { return m_buffer.size() - m_readPos; }
+    void clear();
+    
+private:
+    void compact(qsizetype incoming);
+    
+    QByteArray m_buffer;
+    qsizetype m_readPos;
+    qint32 m_maxFrameSize;
+};
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,211 @@
+#include "IpcDiscovery.h"
+#include "LogCategories.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
+#include <QDebug>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace DiscordDrawRPC {
+
+static constexpr int PIPE_COUNT = 10;
+
+// Discord binds its socket before it listens, give it a moment
+static constexpr int SETTLE_DELAY_MS = 250;
+// How often named pipes are probed for a Discord that started
+static constexpr int PIPE_POLL_INTERVAL_MS = 5000;
+
+IpcDiscovery::IpcDiscovery(QObject* parent)
+    : QObject(parent)
+    , m_watcher(nullptr)
+    , m_settleTimer(new QTimer(this))
+    , m_pollTimer(nullptr)
+{
+    m_settleTimer->setSingleShot(true);
+    connect(m_settleTimer, &QTimer::timeout, this, &IpcDiscovery::onSettled);
+
+#ifndef _WIN32
+    // Locations where Discord might create its socket, in probing order
+    QString runtimeDir = qEnvironmentVariable("XDG_RUNTIME_DIR");
+    QString tmpDir = qEnvironmentVariable("TMPDIR");
+    
+    QStringList dirs;
+    if (!runtimeDir.isEmpty()) {
+        // Flatpak Discord location
+        m_flatpakDir = runtimeDir + "/app/com.discordapp.Discord";
+        dirs << m_flatpakDir << runtimeDir;
+    }
+    dirs << QString("/run/user/%1").arg(getuid());
+    if (!tmpDir.isEmpty()) {
+        dirs << tmpDir;
+    }
+    dirs << "/tmp";
+    
+    for (const QString& dir : dirs) {
+        QString cleaned = QDir::cleanPath(dir);
+        if (!m_searchDirs.contains(cleaned)) {
+            m_searchDirs << cleaned;
+        }
+    }
+#endif
+}
+
+bool IpcDiscovery::exists(const QString& endpoint) {
+#ifdef _WIN32
+    // Asks whether an instance is free without opening, and so using up, one.
+    // A pipe whose instances are all busy still exists.
+    if (WaitNamedPipeW(reinterpret_cast<const wchar_t*>(endpoint.utf16()), 1)) {
+        return true;
+    }
+    DWORD error = GetLastError();
+    return error != ERROR_FILE_NOT_FOUND && error != ERROR_BAD_PATHNAME;
+#else
+    return QFileInfo::exists(endpoint);
+#endif
+}
+
+QStringList IpcDiscovery::endpoints() const {
+    QStringList endpoints;
+
+#ifdef _WIN32
+    // Only pipes that exist, a session per absent pipe would poll for nothing
+    if (!m_lastEndpoint.isEmpty() && exists(m_lastEndpoint)) {
+        endpoints << m_lastEndpoint;
+    }
+    for (int i = 0; i < PIPE_COUNT; ++i) {
+        QString pipe = QString("\\\\.\\pipe\\discord-ipc-%1").arg(i);
+        if (pipe != m_lastEndpoint && exists(pipe)) {
+            endpoints << pipe;
+        }
+    }
+#else
+    // Flatpak sockets are often symlinked into the runtime dir, and two
+    // sessions to the same client would just duplicate every update
+    QSet<QString> sockets;
+    
+    if (!m_lastEndpoint.isEmpty() && QFileInfo::exists(m_lastEndpoint)) {
+        endpoints << m_lastEndpoint;
+        sockets.insert(QFileInfo(m_lastEndpoint).canonicalFilePath());
+    }
+    
+    // One directory listing per location rather than a stat per pipe number
+    static const QRegularExpression pipeName("^discord-ipc-[0-9]$");
+    for (const QString& dir : m_searchDirs) {
+        const QStringList names = QDir(dir).entryList(
+            QStringList() << "discord-ipc-*", QDir::System | QDir::Files, QDir::Name);
+        for (const QString& name : names) {
+            if (!pipeName.match(name).hasMatch()) {
+                continue;
+            }
+            
+            QString path = dir + "/" + name;
+            QString socket = QFileInfo(path).canonicalFilePath();
+            if (!socket.isEmpty() && !sockets.contains(socket)) {
+                sockets.insert(socket);
+                endpoints << path;
+            }
+        }
+    }
+#endif
+
+    return endpoints;
+}
+
+QHash<QString, QDateTime> IpcDiscovery::snapshot() const {
+    // A socket recreated at the same path shows up as a new change time,
+    // pipes have none
+    QHash<QString, QDateTime> endpoints;
+    for (const QString& endpoint : endpoints()) {
+#ifdef _WIN32
+        endpoints.insert(endpoint, QDateTime());
+#else
+        endpoints.insert(endpoint, QFileInfo(endpoint).metadataChangeTime());
+#endif
+    }
+    return endpoints;
+}
+
+void IpcDiscovery::watch() {
+    // Sockets that are already there have just failed to answer
+    m_seen = snapshot();
+    
+#ifdef _WIN32
+    if (!m_pollTimer) {
+        m_pollTimer = new QTimer(this);
+        connect(m_pollTimer, &QTimer::timeout, this, &IpcDiscovery::onSettled);
+    }
+    m_pollTimer->start(PIPE_POLL_INTERVAL_MS);
+#else
+    addWatches();
+#endif
+}
+
+void IpcDiscovery::addWatches() {
+    if (!m_watcher) {
+        m_watcher = new QFileSystemWatcher(this);
+        connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+                this, &IpcDiscovery::onDirectoryChanged);
+    }
+    
+    QStringList dirs = m_searchDirs;
+    if (!m_flatpakDir.isEmpty() && !QFileInfo::exists(m_flatpakDir)) {
+        // Watch the parent so we notice when Flatpak Discord creates its directory
+        dirs << QFileInfo(m_flatpakDir).path();
+    }
+    
+    const QStringList watched = m_watcher->directories();
+    for (const QString& dir : dirs) {
+        if (!watched.contains(dir) && QFileInfo(dir).isDir()) {
+            m_watcher->addPath(dir);
+        }
+    }
+}
+
+void IpcDiscovery::stopWatching() {
+    m_settleTimer->stop();
+    if (m_pollTimer) {
+        m_pollTimer->stop();
+    }
+    if (m_watcher && !m_watcher->directories().isEmpty()) {
+        m_watcher->removePaths(m_watcher->directories());
+    }
+}
+
+void IpcDiscovery::onDirectoryChanged(const QString& path) {
+    // A newly created Flatpak directory has to be watched itself. Its
+    // sockets aren't marked seen here, the lookup below reports them.
+    if (!m_flatpakDir.isEmpty() && path == QFileInfo(m_flatpakDir).path()) {
+        addWatches();
+    }
+    
+    // Bursts of changes (e.g. in /tmp) are folded into one lookup
+    if (!m_settleTimer->isActive()) {
+        m_settleTimer->start(SETTLE_DELAY_MS);
+    }
+}
+
+void IpcDiscovery::onSettled() {
+    QHash<QString, QDateTime> current = snapshot();
+    
+    bool appeared = false;
+    for (auto it = current.constBegin(); it != current.constEnd(); ++it) {
+        if (!m_seen.contains(it.key()) || m_seen.value(it.key()) != it.value()) {
+            appeared = true;
+            break;
+        }
+    }
+    m_seen = current;
+    
+    if (appeared) {
+        qCDebug(lcRpcIo) << "Discord IPC socket appeared";
+        emit socketAppeared();
+    }
+}
+
+} // namespace DiscordDrawRPC
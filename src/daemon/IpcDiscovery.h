@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QStringList>
+#include <QHash>
+#include <QDateTime>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Finds the IPC endpoints Discord clients are listening on.
+ * Every running client (stable, PTB, Canary, Flatpak) binds its own
+ * discord-ipc-N, so all of them are reported, the last endpoint that
+ * completed a handshake first.
+ * On Unix the candidate directories are listed once per lookup instead of
+ * stat'ing every discord-ipc-N path, and can be watched so that a new
+ * Discord socket is reported the moment it appears. Windows named pipes
+ * can't be listed or watched, there each pipe number is probed, every few
+ * seconds while watching.
+ */
+class IpcDiscovery : public QObject {
+    Q_OBJECT
+    
+public:
+    explicit IpcDiscovery(QObject* parent = nullptr);
+    
+    // Endpoints worth connecting to, most likely first, one per socket
+    QStringList endpoints() const;
+    
+    // Remember an endpoint that accepted a handshake
+    void remember(const QString& endpoint) { m_lastEndpoint = endpoint; }
+    // Report the endpoint again once it is there, its client went away
+    void forget(const QString& endpoint) { m_seen.remove(endpoint); }
+    
+    // Whether a Discord client is listening on the endpoint right now
+    static bool exists(const QString& endpoint);
+    
+    void watch();
+    void stopWatching();
+    
+signals:
+    void socketAppeared();
+    
+private slots:
+    void onDirectoryChanged(const QString& path);
+    void onSettled();
+    
+private:
+    QHash<QString, QDateTime> snapshot() const;
+    void addWatches();
+    
+    QStringList m_searchDirs;
+    QString m_flatpakDir;
+    QString m_lastEndpoint;
+    QHash<QString, QDateTime> m_seen;
+    QFileSystemWatcher* m_watcher;
+    QTimer* m_settleTimer;
+    // Windows only, stands in for the watcher
+    QTimer* m_pollTimer;
+};
+
+} // namespace DiscordDrawRPC
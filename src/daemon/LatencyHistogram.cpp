@@ -0,0 +1,73 @@
+#include "LatencyHistogram.h"
+#include <cmath>
+
+namespace DiscordDrawRPC {
+
+// Each bucket covers 20% more than the previous one: 1.2^100 us is about 83 s
+static constexpr double BUCKET_GROWTH = 1.2;
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    m_buckets.fill(0);
+    m_count = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+int LatencyHistogram::bucketFor(qint64 micros) {
+    if (micros <= 1) {
+        return 0;
+    }
+    
+    int bucket = static_cast<int>(std::ceil(std::log(double(micros)) / std::log(BUCKET_GROWTH)));
+    return qBound(0, bucket, BUCKET_COUNT - 1);
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int bucket) {
+    return static_cast<qint64>(std::ceil(std::pow(BUCKET_GROWTH, bucket)));
+}
+
+void LatencyHistogram::record(qint64 micros) {
+    micros = qMax<qint64>(0, micros);
+    
+    m_buckets[bucketFor(micros)]++;
+    m_count++;
+    m_sum += micros;
+    m_max = qMax(m_max, micros);
+}
+
+qint64 LatencyHistogram::percentile(double p) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    
+    quint64 target = static_cast<quint64>(std::ceil(qBound(0.0, p, 100.0) / 100.0 * m_count));
+    target = qMax<quint64>(target, 1);
+    
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_buckets[i];
+        if (seen >= target) {
+            // Never report more than was actually observed
+            return qMin(bucketUpperBound(i), m_max);
+        }
+    }
+    
+    return m_max;
+}
+
+QJsonObject LatencyHistogram::toJson() const {
+    QJsonObject json;
+    json["count"] = static_cast<qint64>(m_count);
+    json["mean_ms"] = mean() / 1000.0;
+    json["p50_ms"] = percentile(50) / 1000.0;
+    json["p95_ms"] = percentile(95) / 1000.0;
+    json["p99_ms"] = percentile(99) / 1000.0;
+    json["max_ms"] = m_max / 1000.0;
+    return json;
+}
+
+} // namespace DiscordDrawRPC
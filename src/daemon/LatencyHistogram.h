@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <array>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Fixed-size latency histogram with exponentially growing buckets.
+ * Records microseconds from 1 us up to about a minute with a relative
+ * error of at most 20%, using constant memory no matter how many samples.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    
+    void record(qint64 micros);
+    void reset();
+    
+    quint64 count() const { return m_count; }
+    qint64 max() const { return m_max; }
+    qint64 sum() const { return m_sum; }
+    double mean() const { return m_count ? double(m_sum) / m_count : 0.0; }
+    
+    // Upper bound of the bucket holding the given percentile (0-100), in microseconds
+    qint64 percentile(double p) const;
+    
+    // count, mean/p50/p95/p99/max in milliseconds
+    QJsonObject toJson() const;
+    
+private:
+    static constexpr int BUCKET_COUNT = 100;
+    
+    static int bucketFor(qint64 micros);
+    static qint64 bucketUpperBound(int bucket);
+    
+    std::array<quint64, BUCKET_COUNT> m_buckets;
+    quint64 m_count;
+    qint64 m_sum;
+    qint64 m_max;
+};
+
+} // namespace DiscordDrawRPC
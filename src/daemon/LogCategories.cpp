@@ -0,0 +1,34 @@
+#include "LogCategories.h"
+#include <QStringList>
+
+namespace DiscordDrawRPC {
+
+Q_LOGGING_CATEGORY(lcRpcIo, "rpc.io")
+// Dumps payloads, only worth its cost when debugging the protocol
+Q_LOGGING_CATEGORY(lcRpcFrames, "rpc.frames", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcDaemonState, "daemon.state")
+Q_LOGGING_CATEGORY(lcDaemonLifecycle, "daemon.lifecycle")
+
+void applyLogLevels(const QJsonObject& levels) {
+    // In increasing severity, as QLoggingCategory names them in filter rules
+    static const QStringList LEVEL_NAMES = { "debug", "info", "warning", "critical" };
+    
+    QStringList rules;
+    for (auto it = levels.constBegin(); it != levels.constEnd(); ++it) {
+        int minimum = LEVEL_NAMES.indexOf(it.value().toString().toLower());
+        if (minimum < 0) {
+            qCWarning(lcDaemonLifecycle) << "Unknown log level for" << it.key() << ":" << it.value().toString();
+            continue;
+        }
+        
+        for (int level = 0; level < LEVEL_NAMES.size(); ++level) {
+            rules.append(QString("%1.%2=%3").arg(it.key(), LEVEL_NAMES[level], level >= minimum ? "true" : "false"));
+        }
+    }
+    
+    // Even when empty, so levels removed from the file stop applying and
+    // the categories fall back to their defaults
+    QLoggingCategory::setFilterRules(rules.join('\n'));
+}
+
+} // namespace DiscordDrawRPC
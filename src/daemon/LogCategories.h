@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QLoggingCategory>
+#include <QJsonObject>
+
+namespace DiscordDrawRPC {
+
+// The qC* macros check whether a category is enabled before the message
+// arguments are evaluated, so disabled debug output costs a branch
+Q_DECLARE_LOGGING_CATEGORY(lcRpcIo)             // Discord IPC connections and socket errors
+Q_DECLARE_LOGGING_CATEGORY(lcRpcFrames)         // Every Discord IPC frame sent and received
+Q_DECLARE_LOGGING_CATEGORY(lcDaemonState)       // Presence updates and the state file
+Q_DECLARE_LOGGING_CATEGORY(lcDaemonLifecycle)   // Startup, shutdown, sessions and the control socket
+
+// Set the lowest level logged per category from the config's "log_levels",
+// e.g. { "rpc.frames": "debug" }; QT_LOGGING_RULES still overrides these
+void applyLogLevels(const QJsonObject& levels);
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,125 @@
+#include "Metrics.h"
+#include <QMutexLocker>
+
+namespace DiscordDrawRPC {
+
+static const char METRIC_PREFIX[] = "discord_drawing_rpc_";
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+// Indexed by Metrics::Counter
+static const MetricInfo COUNTER_INFO[] = {
+    { "frames_sent_total", "Discord IPC frames written." },
+    { "frames_received_total", "Discord IPC frames decoded." },
+    { "bytes_sent_total", "Bytes written to Discord IPC sockets." },
+    { "bytes_received_total", "Bytes read from Discord IPC sockets." },
+    { "connect_attempts_total", "Connection attempts to a Discord client." },
+    { "connects_total", "Connection attempts that completed the handshake." },
+    { "presence_applied_total", "Presence updates Discord acknowledged." },
+    { "presence_suppressed_total", "Presence updates not sent because Discord already showed them." },
+    { "presence_coalesced_total", "Presence updates replaced by a newer one before being sent." },
+    { "state_reads_total", "Reads of the persisted state file." },
+};
+static_assert(sizeof(COUNTER_INFO) / sizeof(COUNTER_INFO[0]) == Metrics::CounterCount,
+              "Every counter needs a name");
+
+// Indexed by Metrics::Summary
+static const MetricInfo SUMMARY_INFO[] = {
+    { "handshake_duration_seconds", "Time from sending the handshake to Discord's READY." },
+    { "queue_wait_seconds", "Time presence updates waited for the connection and rate limiter." },
+    { "event_loop_lag_seconds", "Delay of a periodic timer beyond its interval." },
+};
+static_assert(sizeof(SUMMARY_INFO) / sizeof(SUMMARY_INFO[0]) == Metrics::SummaryCount,
+              "Every summary needs a name");
+
+static const double QUANTILES[] = { 0.5, 0.95, 0.99 };
+
+static void writeHeader(QByteArray& out, const char* name, const char* help, const char* type) {
+    out.append("# HELP ").append(METRIC_PREFIX).append(name).append(' ').append(help).append('\n');
+    out.append("# TYPE ").append(METRIC_PREFIX).append(name).append(' ').append(type).append('\n');
+}
+
+// Quantiles, sum and count of one summary series; labels are "key=\"value\"" or empty
+static void writeSummary(QByteArray& out, const char* name, const QByteArray& labels, const LatencyHistogram& histogram) {
+    for (double quantile : QUANTILES) {
+        out.append(METRIC_PREFIX).append(name).append('{');
+        if (!labels.isEmpty()) {
+            out.append(labels).append(',');
+        }
+        out.append("quantile=\"").append(QByteArray::number(quantile)).append("\"} ");
+        out.append(QByteArray::number(histogram.percentile(quantile * 100) / 1e6, 'g', 9)).append('\n');
+    }
+    
+    QByteArray suffixLabels = labels.isEmpty() ? QByteArray() : '{' + labels + '}';
+    out.append(METRIC_PREFIX).append(name).append("_sum").append(suffixLabels).append(' ');
+    out.append(QByteArray::number(histogram.sum() / 1e6, 'g', 12)).append('\n');
+    out.append(METRIC_PREFIX).append(name).append("_count").append(suffixLabels).append(' ');
+    out.append(QByteArray::number(histogram.count())).append('\n');
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics() {
+    for (auto& counter : m_counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::observe(Summary summary, qint64 micros) {
+    QMutexLocker locker(&m_mutex);
+    m_summaries[summary].record(micros);
+}
+
+void Metrics::observeCommand(const QString& cmd, qint64 micros) {
+    QMutexLocker locker(&m_mutex);
+    m_commands[cmd].record(micros);
+}
+
+QJsonObject Metrics::summaryJson(Summary summary) const {
+    QMutexLocker locker(&m_mutex);
+    return m_summaries[summary].toJson();
+}
+
+QJsonObject Metrics::commandJson() const {
+    QMutexLocker locker(&m_mutex);
+    
+    QJsonObject commands;
+    for (auto it = m_commands.constBegin(); it != m_commands.constEnd(); ++it) {
+        commands[it.key()] = it.value().toJson();
+    }
+    return commands;
+}
+
+QByteArray Metrics::toPrometheus() const {
+    QByteArray out;
+    out.reserve(4096);
+    
+    for (int i = 0; i < CounterCount; ++i) {
+        writeHeader(out, COUNTER_INFO[i].name, COUNTER_INFO[i].help, "counter");
+        out.append(METRIC_PREFIX).append(COUNTER_INFO[i].name).append(' ');
+        out.append(QByteArray::number(value(static_cast<Counter>(i)))).append('\n');
+    }
+    
+    QMutexLocker locker(&m_mutex);
+    
+    for (int i = 0; i < SummaryCount; ++i) {
+        writeHeader(out, SUMMARY_INFO[i].name, SUMMARY_INFO[i].help, "summary");
+        writeSummary(out, SUMMARY_INFO[i].name, QByteArray(), m_summaries[i]);
+    }
+    
+    writeHeader(out, "command_duration_seconds", "Round trip of Discord RPC commands.", "summary");
+    for (auto it = m_commands.constBegin(); it != m_commands.constEnd(); ++it) {
+        // Command names are Discord's upper-case identifiers, nothing to escape
+        writeSummary(out, "command_duration_seconds", "cmd=\"" + it.key().toLatin1() + '"', it.value());
+    }
+    
+    return out;
+}
+
+} // namespace DiscordDrawRPC
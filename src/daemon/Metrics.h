@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QMap>
+#include <QMutex>
+#include <QJsonObject>
+#include <array>
+#include <atomic>
+#include "LatencyHistogram.h"
+
+namespace DiscordDrawRPC {
+
+/**
+ * Process-wide metrics registry of the daemon.
+ * Counters are lock-free atomics so they can be bumped from any thread on
+ * hot paths; latency summaries are kept in LatencyHistograms behind a mutex.
+ * Everything is exported in the Prometheus text exposition format.
+ */
+class Metrics {
+public:
+    enum Counter {
+        FramesSent,
+        FramesReceived,
+        BytesSent,
+        BytesReceived,
+        ConnectAttempts,
+        Connects,
+        PresenceApplied,
+        PresenceSuppressed,
+        PresenceCoalesced,
+        StateReads,
+        CounterCount
+    };
+    
+    enum Summary {
+        HandshakeDuration,
+        QueueWait,
+        EventLoopLag,
+        SummaryCount
+    };
+    
+    static Metrics& instance();
+    
+    void increment(Counter counter, quint64 amount = 1) {
+        m_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+    quint64 value(Counter counter) const {
+        return m_counters[counter].load(std::memory_order_relaxed);
+    }
+    
+    void observe(Summary summary, qint64 micros);
+    // Discord round trip, labeled by command
+    void observeCommand(const QString& cmd, qint64 micros);
+    
+    // Latency summaries for the control socket's stats request
+    QJsonObject summaryJson(Summary summary) const;
+    QJsonObject commandJson() const;
+    
+    // Prometheus text exposition format, version 0.0.4
+    QByteArray toPrometheus() const;
+    
+private:
+    Metrics();
+    
+    std::array<std::atomic<quint64>, CounterCount> m_counters;
+    
+    mutable QMutex m_mutex;
+    std::array<LatencyHistogram, SummaryCount> m_summaries;
+    QMap<QString, LatencyHistogram> m_commands;
+};
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,168 @@
+#include "PresenceQueue.h"
+#include "LogCategories.h"
+#include "Metrics.h"
+#include "StartupMarkers.h"
+#include <QDebug>
+#include <cmath>
+
+namespace DiscordDrawRPC {
+
+// Discord's SET_ACTIVITY rate limit
+static constexpr int RATE_LIMIT_BURST = 5;
+static constexpr int RATE_LIMIT_WINDOW_MS = 20000;
+static constexpr double TOKEN_INTERVAL_MS = double(RATE_LIMIT_WINDOW_MS) / RATE_LIMIT_BURST;
+
+// Canonical form of a cleared presence
+static const char CLEARED_CANONICAL[] = "null";
+
+PresenceQueue::PresenceQueue(DiscordRPC* rpc, QObject* parent)
+    : QObject(parent)
+    , m_rpc(rpc)
+    , m_flushTimer(new QTimer(this))
+    , m_tokens(RATE_LIMIT_BURST)
+    , m_pending(Pending::None)
+    , m_inFlightNonce(0)
+    , m_suppressed(0)
+    , m_coalesced(0)
+{
+    m_refillClock.start();
+    
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &PresenceQueue::flush);
+    
+    // Whatever is pending goes out as soon as Discord is reachable again
+    connect(m_rpc, &DiscordRPC::connected, this, &PresenceQueue::flush);
+    connect(m_rpc, &DiscordRPC::disconnected, this, &PresenceQueue::onDisconnected);
+    connect(m_rpc, &DiscordRPC::responseReceived, this, &PresenceQueue::onResponseReceived);
+    connect(m_rpc, &DiscordRPC::commandDropped, this, &PresenceQueue::onCommandDropped);
+}
+
+void PresenceQueue::submitUpdate(const QByteArray& activity) {
+    if (m_pending != Pending::None) {
+        qCDebug(lcDaemonState) << "Coalescing presence update with pending one";
+        m_coalesced++;
+        Metrics::instance().increment(Metrics::PresenceCoalesced);
+    } else {
+        m_pendingSince.start();
+    }
+    
+    m_pending = Pending::Update;
+    m_pendingActivity = activity;
+    flush();
+}
+
+void PresenceQueue::submitClear() {
+    if (m_pending != Pending::None) {
+        m_coalesced++;
+        Metrics::instance().increment(Metrics::PresenceCoalesced);
+    } else {
+        m_pendingSince.start();
+    }
+    
+    m_pending = Pending::Clear;
+    m_pendingActivity.clear();
+    flush();
+}
+
+QByteArray PresenceQueue::pendingCanonical() const {
+    if (m_pending == Pending::Clear) {
+        // Refers to the literal instead of copying it
+        return QByteArray::fromRawData(CLEARED_CANONICAL, sizeof(CLEARED_CANONICAL) - 1);
+    }
+    return m_pendingActivity;
+}
+
+void PresenceQueue::refillTokens() {
+    double elapsed = static_cast<double>(m_refillClock.restart());
+    m_tokens = qMin<double>(RATE_LIMIT_BURST, m_tokens + elapsed / TOKEN_INTERVAL_MS);
+}
+
+void PresenceQueue::flush() {
+    if (m_pending == Pending::None) {
+        return;
+    }
+    
+    if (!m_rpc->isConnected()) {
+        // Held until connected() fires, reconnecting is up to the owner
+        return;
+    }
+    
+    QByteArray canonical = pendingCanonical();
+    if (canonical == m_ackedCanonical || canonical == m_inFlightCanonical) {
+        qCDebug(lcDaemonState) << "Presence unchanged, not sending it again";
+        m_suppressed++;
+        Metrics::instance().increment(Metrics::PresenceSuppressed);
+        m_pending = Pending::None;
+        m_pendingActivity.clear();
+        m_flushTimer->stop();
+        return;
+    }
+    
+    refillTokens();
+    if (m_tokens < 1.0) {
+        if (!m_flushTimer->isActive()) {
+            int waitMs = static_cast<int>(std::ceil((1.0 - m_tokens) * TOKEN_INTERVAL_MS));
+            qCDebug(lcDaemonState) << "Presence update rate limited, sending in" << waitMs << "ms";
+            m_flushTimer->start(waitMs);
+        }
+        return;
+    }
+    
+    m_flushTimer->stop();
+    m_tokens -= 1.0;
+    
+    // Written out by the RPC's own thread, an empty activity clears
+    quint64 nonce = m_rpc->postPresence(m_pending == Pending::Update ? m_pendingActivity : QByteArray());
+    if (nonce == 0) {
+        qCWarning(lcDaemonState) << "Failed to send presence to Discord";
+    } else {
+        m_inFlightNonce = nonce;
+        m_inFlightCanonical = canonical;
+        markStartup("presence_sent");
+        Metrics::instance().observe(Metrics::QueueWait, m_pendingSince.nsecsElapsed() / 1000);
+    }
+    
+    m_pending = Pending::None;
+    m_pendingActivity.clear();
+}
+
+void PresenceQueue::onResponseReceived(quint64 nonce, const QJsonObject& response) {
+    if (nonce != m_inFlightNonce) {
+        return;
+    }
+    
+    if (response.value("evt").toString() == "ERROR") {
+        // Discord kept whatever it had before, which we can't know for sure
+        m_ackedCanonical.clear();
+    } else {
+        m_ackedCanonical = m_inFlightCanonical;
+        Metrics::instance().increment(Metrics::PresenceApplied);
+    }
+    
+    m_inFlightNonce = 0;
+    m_inFlightCanonical.clear();
+    
+    if (!m_ackedCanonical.isEmpty()) {
+        emit applied();
+    }
+}
+
+void PresenceQueue::onCommandDropped(quint64 nonce) {
+    if (nonce != m_inFlightNonce) {
+        return;
+    }
+    
+    // The connection went away first, it restores the presence when it's back
+    qCWarning(lcDaemonState) << "Failed to send presence to Discord";
+    m_inFlightNonce = 0;
+    m_inFlightCanonical.clear();
+}
+
+void PresenceQueue::onDisconnected() {
+    // Discord drops the activity together with the connection
+    m_ackedCanonical.clear();
+    m_inFlightNonce = 0;
+    m_inFlightCanonical.clear();
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QByteArray>
+#include "DiscordRPC.h"
+
+namespace DiscordDrawRPC {
+
+/**
+ * Latest-wins queue in front of DiscordRPC's SET_ACTIVITY.
+ * Discord accepts about 5 activity updates per 20 seconds, so updates are
+ * paced with a token bucket; anything submitted while waiting for a token
+ * or for the connection replaces the pending update instead of queueing.
+ * 
+ * Presences are submitted already serialized in canonical form (compact
+ * JSON with sorted keys), so the same bytes can be handed to several queues
+ * and are compared against the last presence Discord acknowledged; identical
+ * ones are never sent again.
+ */
+class PresenceQueue : public QObject {
+    Q_OBJECT
+    
+public:
+    explicit PresenceQueue(DiscordRPC* rpc, QObject* parent = nullptr);
+    
+    void submitUpdate(const QByteArray& activity);
+    void submitClear();
+    
+    bool hasPending() const { return m_pending != Pending::None; }
+    
+    // Updates dropped because Discord already shows the same presence
+    quint64 suppressedCount() const { return m_suppressed; }
+    // Updates replaced by a newer one before they could be sent
+    quint64 coalescedCount() const { return m_coalesced; }
+    
+signals:
+    // Discord acknowledged the presence that was last sent
+    void applied();
+    
+private slots:
+    void flush();
+    void onResponseReceived(quint64 nonce, const QJsonObject& response);
+    void onCommandDropped(quint64 nonce);
+    void onDisconnected();
+    
+private:
+    enum class Pending {
+        None,
+        Update,
+        Clear
+    };
+    
+    void refillTokens();
+    QByteArray pendingCanonical() const;
+    
+    DiscordRPC* m_rpc;
+    QTimer* m_flushTimer;
+    QElapsedTimer m_refillClock;
+    double m_tokens;
+    Pending m_pending;
+    QByteArray m_pendingActivity;
+    QElapsedTimer m_pendingSince;
+    
+    // Canonical presence Discord confirmed, empty while unknown
+    QByteArray m_ackedCanonical;
+    // Canonical presence sent and not answered yet
+    QByteArray m_inFlightCanonical;
+    quint64 m_inFlightNonce;
+    
+    quint64 m_suppressed;
+    quint64 m_coalesced;
+};
+
+} // namespace DiscordDrawRPC
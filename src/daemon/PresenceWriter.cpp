@@ -0,0 +1,262 @@
+#include "PresenceWriter.h"
+#include <QJsonArray>
+#include <QStringView>
+#include <QtEndian>
+#include <array>
+#include <charconv>
+#include <cstring>
+
+namespace DiscordDrawRPC {
+
+// Discord IPC frame header and the FRAME opcode commands are sent with
+static constexpr qsizetype FRAME_HEADER_SIZE = 8;
+static constexpr qint32 OPCODE_FRAME = 1;
+
+// Room for every key, bracket and separator of an activity plus one number
+static constexpr qsizetype ACTIVITY_FIXED_SIZE = 256;
+// Header, envelope and two numbers around the activity
+static constexpr qsizetype FRAME_FIXED_SIZE = 128;
+// A UTF-16 unit is at most \u00XX once escaped, a surrogate pair 4 UTF-8 bytes
+static constexpr qsizetype MAX_ESCAPED_UNIT_SIZE = 6;
+
+// How each ASCII character is written inside a JSON string, the way
+// QJsonDocument does it: 0 copies it as is, 'u' means \u00XX and anything
+// else follows a backslash
+static constexpr std::array<char, 128> ESCAPES = []() {
+    std::array<char, 128> escapes{};
+    for (int c = 0; c < 0x20; ++c) {
+        escapes[c] = 'u';
+    }
+    escapes['\b'] = 'b';
+    escapes['\f'] = 'f';
+    escapes['\n'] = 'n';
+    escapes['\r'] = 'r';
+    escapes['\t'] = 't';
+    escapes['"'] = '"';
+    escapes['\\'] = '\\';
+    return escapes;
+}();
+
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+// Literal lengths are known at compile time, nothing is scanned or escaped
+template <size_t N>
+static inline char* writeLiteral(char* out, const char (&text)[N]) {
+    std::memcpy(out, text, N - 1);
+    return out + N - 1;
+}
+
+template <typename Integer>
+static inline char* writeNumber(char* out, Integer value) {
+    // 20 characters fit any 64-bit integer, sign included
+    return std::to_chars(out, out + 20, value).ptr;
+}
+
+// Quoted, escaped and encoded as UTF-8
+static char* writeString(char* out, QStringView text) {
+    *out++ = '"';
+    
+    const char16_t* it = text.utf16();
+    const char16_t* end = it + text.size();
+    while (it != end) {
+        char32_t c = *it++;
+        if (c < 0x80) {
+            char escape = ESCAPES[c];
+            if (escape == 0) {
+                *out++ = static_cast<char>(c);
+            } else if (escape != 'u') {
+                *out++ = '\\';
+                *out++ = escape;
+            } else {
+                out = writeLiteral(out, "\\u00");
+                *out++ = HEX_DIGITS[c >> 4];
+                *out++ = HEX_DIGITS[c & 0xf];
+            }
+            continue;
+        }
+        
+        if (c < 0x800) {
+            *out++ = static_cast<char>(0xc0 | (c >> 6));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+            continue;
+        }
+        
+        if (QChar::isHighSurrogate(c) && it != end && QChar::isLowSurrogate(*it)) {
+            c = QChar::surrogateToUcs4(static_cast<char16_t>(c), *it++);
+            *out++ = static_cast<char>(0xf0 | (c >> 18));
+            *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+            continue;
+        }
+        
+        // A surrogate without its other half can't be encoded
+        if (QChar::isSurrogate(c)) {
+            c = QChar::ReplacementCharacter;
+        }
+        *out++ = static_cast<char>(0xe0 | (c >> 12));
+        *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        *out++ = static_cast<char>(0x80 | (c & 0x3f));
+    }
+    
+    *out++ = '"';
+    return out;
+}
+
+Presence Presence::fromState(const QJsonObject& stateData) {
+    Presence presence;
+    presence.state = stateData.value("state").toString();
+    presence.details = stateData.value("details").toString();
+    presence.start = stateData.value("start").toVariant().toLongLong();
+    
+    // Texts only show as tooltips of their image
+    presence.largeImage = stateData.value("large_image").toString();
+    if (!presence.largeImage.isEmpty()) {
+        presence.largeText = stateData.value("large_text").toString();
+    }
+    presence.smallImage = stateData.value("small_image").toString();
+    if (!presence.smallImage.isEmpty()) {
+        presence.smallText = stateData.value("small_text").toString();
+    }
+    
+    const QJsonArray buttons = stateData.value("buttons").toArray();
+    for (const QJsonValue& value : buttons) {
+        QJsonObject button = value.toObject();
+        Button& entry = presence.buttons[presence.buttonCount];
+        entry.label = button.value("label").toString();
+        entry.url = button.value("url").toString();
+        if (!entry.label.isEmpty() && !entry.url.isEmpty() && ++presence.buttonCount == MAX_BUTTONS) {
+            break;
+        }
+    }
+    
+    return presence;
+}
+
+char* PresenceWriter::begin(qsizetype maxSize) {
+    // Shrinking back in finish() keeps the capacity, so this only
+    // allocates until the buffer has grown to fit the largest presence
+    m_buffer.resize(maxSize);
+    return m_buffer.data();
+}
+
+const QByteArray& PresenceWriter::finish(const char* end) {
+    m_buffer.resize(end - m_buffer.constData());
+    return m_buffer;
+}
+
+const QByteArray& PresenceWriter::writeActivity(const Presence& presence) {
+    bool hasAssets = !presence.largeImage.isEmpty() || !presence.smallImage.isEmpty();
+    
+    qsizetype textSize = presence.state.size() + presence.details.size()
+        + presence.largeImage.size() + presence.largeText.size()
+        + presence.smallImage.size() + presence.smallText.size();
+    for (int i = 0; i < presence.buttonCount; ++i) {
+        textSize += presence.buttons[i].label.size() + presence.buttons[i].url.size();
+    }
+    
+    char* out = begin(ACTIVITY_FIXED_SIZE + textSize * MAX_ESCAPED_UNIT_SIZE);
+    
+    // Keys in sorted order, as the presence is compared in this form
+    char separator = '{';
+    if (hasAssets) {
+        *out++ = separator;
+        separator = ',';
+        out = writeLiteral(out, "\"assets\":");
+        
+        char assetSeparator = '{';
+        if (!presence.largeImage.isEmpty()) {
+            *out++ = assetSeparator;
+            assetSeparator = ',';
+            out = writeLiteral(out, "\"large_image\":");
+            out = writeString(out, presence.largeImage);
+            if (!presence.largeText.isEmpty()) {
+                out = writeLiteral(out, ",\"large_text\":");
+                out = writeString(out, presence.largeText);
+            }
+        }
+        if (!presence.smallImage.isEmpty()) {
+            *out++ = assetSeparator;
+            out = writeLiteral(out, "\"small_image\":");
+            out = writeString(out, presence.smallImage);
+            if (!presence.smallText.isEmpty()) {
+                out = writeLiteral(out, ",\"small_text\":");
+                out = writeString(out, presence.smallText);
+            }
+        }
+        *out++ = '}';
+    }
+    
+    if (presence.buttonCount > 0) {
+        *out++ = separator;
+        separator = ',';
+        out = writeLiteral(out, "\"buttons\":[");
+        for (int i = 0; i < presence.buttonCount; ++i) {
+            if (i > 0) {
+                *out++ = ',';
+            }
+            out = writeLiteral(out, "{\"label\":");
+            out = writeString(out, presence.buttons[i].label);
+            out = writeLiteral(out, ",\"url\":");
+            out = writeString(out, presence.buttons[i].url);
+            *out++ = '}';
+        }
+        *out++ = ']';
+    }
+    
+    if (!presence.details.isEmpty()) {
+        *out++ = separator;
+        separator = ',';
+        out = writeLiteral(out, "\"details\":");
+        out = writeString(out, presence.details);
+    }
+    
+    if (!presence.state.isEmpty()) {
+        *out++ = separator;
+        separator = ',';
+        out = writeLiteral(out, "\"state\":");
+        out = writeString(out, presence.state);
+    }
+    
+    if (presence.start > 0) {
+        *out++ = separator;
+        separator = ',';
+        out = writeLiteral(out, "\"timestamps\":{\"start\":");
+        out = writeNumber(out, presence.start);
+        *out++ = '}';
+    }
+    
+    // Nothing written yet for an empty presence
+    if (separator == '{') {
+        *out++ = '{';
+    }
+    *out++ = '}';
+    
+    return finish(out);
+}
+
+const QByteArray& PresenceWriter::writeSetActivityFrame(const QByteArray& activity, qint64 pid, quint64 nonce) {
+    char* frame = begin(FRAME_FIXED_SIZE + activity.size());
+    char* out = frame + FRAME_HEADER_SIZE;
+    
+    out = writeLiteral(out, "{\"cmd\":\"SET_ACTIVITY\",\"args\":{");
+    if (!activity.isEmpty()) {
+        out = writeLiteral(out, "\"activity\":");
+        std::memcpy(out, activity.constData(), activity.size());
+        out += activity.size();
+        *out++ = ',';
+    }
+    out = writeLiteral(out, "\"pid\":");
+    out = writeNumber(out, pid);
+    out = writeLiteral(out, "},\"nonce\":\"");
+    out = writeNumber(out, nonce);
+    out = writeLiteral(out, "\"}");
+    
+    // The payload length is only known now
+    qToLittleEndian<qint32>(OPCODE_FRAME, frame);
+    qToLittleEndian<qint32>(static_cast<qint32>(out - frame - FRAME_HEADER_SIZE), frame + 4);
+    
+    return finish(out);
+}
+
+} // namespace DiscordDrawRPC
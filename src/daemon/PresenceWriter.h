@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+namespace DiscordDrawRPC {
+
+// Fields of an "update" command, as the control socket and state file carry them
+struct Presence {
+    struct Button {
+        QString label;
+        QString url;
+    };
+    
+    // Discord shows at most two buttons
+    static constexpr int MAX_BUTTONS = 2;
+    
+    QString state;
+    QString details;
+    qint64 start = 0;
+    QString largeImage;
+    QString largeText;
+    QString smallImage;
+    QString smallText;
+    Button buttons[MAX_BUTTONS];
+    int buttonCount = 0;
+    
+    static Presence fromState(const QJsonObject& stateData);
+};
+
+/**
+ * Serializer for the presence path: the activity as canonical compact JSON
+ * (sorted keys, like QJsonDocument writes it) and the whole SET_ACTIVITY
+ * frame around it, header included.
+ * 
+ * Both are written straight into one buffer that is reused from call to
+ * call, sized up front for the worst case, so once it has grown to fit no
+ * call allocates. Keys and punctuation are compile-time literals copied
+ * as is; only string values go through escaping, one table lookup per
+ * ASCII character.
+ */
+class PresenceWriter {
+public:
+    // Valid until the next call; copy it out to keep it, sharing the
+    // buffer would make the next call allocate a new one
+    const QByteArray& writeActivity(const Presence& presence);
+    
+    // An empty activity clears the presence. Valid until the next call.
+    const QByteArray& writeSetActivityFrame(const QByteArray& activity, qint64 pid, quint64 nonce);
+    
+private:
+    // Make room for maxSize bytes and return where to write them
+    char* begin(qsizetype maxSize);
+    const QByteArray& finish(const char* end);
+    
+    QByteArray m_buffer;
+};
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,48 @@
+#include "ServiceNotify.h"
+#include "LogCategories.h"
+#include <QtGlobal>
+#include <QByteArray>
+#include <QDebug>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace DiscordDrawRPC {
+
+void notifyService(const char* state) {
+#ifdef _WIN32
+    Q_UNUSED(state);
+#else
+    QByteArray path = qgetenv(NOTIFY_SOCKET_ENV);
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    sockaddr_un address;
+    socklen_t length = notifySocketAddress(path, address);
+    if (length == 0) {
+        qCWarning(lcDaemonLifecycle) << "Notify socket path too long:" << path;
+        return;
+    }
+    
+    int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        qCWarning(lcDaemonLifecycle) << "Failed to create notify socket:" << std::strerror(errno);
+        return;
+    }
+    
+    if (::sendto(fd, state, std::strlen(state), 0, reinterpret_cast<sockaddr*>(&address), length) < 0) {
+        qCWarning(lcDaemonLifecycle) << "Failed to notify" << path << "of" << state << ":" << std::strerror(errno);
+    } else {
+        qCDebug(lcDaemonLifecycle) << "Notified" << path << "of" << state;
+    }
+    ::close(fd);
+#endif
+}
+
+} // namespace DiscordDrawRPC
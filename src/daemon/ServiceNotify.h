@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../common/NotifySocket.h"
+
+namespace DiscordDrawRPC {
+
+// Tell whoever launched us about a state change (NOTIFY_READY, NOTIFY_STOPPING)
+// with systemd's sd_notify() protocol: one datagram to the Unix socket named
+// by NOTIFY_SOCKET, '@' standing for the abstract namespace. Does nothing
+// when the variable isn't set, or on Windows.
+void notifyService(const char* state);
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,57 @@
+#include "SocketActivation.h"
+#include "LogCategories.h"
+#include <QByteArray>
+#include <QDebug>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace DiscordDrawRPC {
+
+qintptr takeActivatedSocket() {
+#ifdef _WIN32
+    return -1;
+#else
+    QByteArray pid = qgetenv(LISTEN_PID_ENV);
+    QByteArray count = qgetenv(LISTEN_FDS_ENV);
+    qunsetenv(LISTEN_PID_ENV);
+    qunsetenv(LISTEN_FDS_ENV);
+    qunsetenv(LISTEN_FDNAMES_ENV);
+    
+    // Inherited from a parent that was activated itself, not meant for us
+    if (count.isEmpty() || pid.toLongLong() != ::getpid()) {
+        return -1;
+    }
+    
+    int fds = count.toInt();
+    if (fds < 1) {
+        return -1;
+    }
+    if (fds > 1) {
+        qCWarning(lcDaemonLifecycle) << "Passed" << fds << "sockets, only the first one is used";
+    }
+    
+    // Anything but a listening Unix stream socket is a misconfigured unit
+    int fd = LISTEN_FDS_START;
+    sockaddr_un address;
+    socklen_t length = sizeof(address);
+    int type = 0;
+    socklen_t typeSize = sizeof(type);
+    int listening = 0;
+    socklen_t listeningSize = sizeof(listening);
+    if (::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0
+        || address.sun_family != AF_UNIX
+        || ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeSize) < 0 || type != SOCK_STREAM
+        || ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &listeningSize) < 0 || !listening) {
+        qCWarning(lcDaemonLifecycle) << "Passed descriptor" << fd << "is not a listening Unix stream socket";
+        return -1;
+    }
+    
+    return fd;
+#endif
+}
+
+} // namespace DiscordDrawRPC
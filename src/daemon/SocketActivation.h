@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QtGlobal>
+
+namespace DiscordDrawRPC {
+
+// Environment variables systemd passes sockets in, and the first descriptor
+// they start at (SD_LISTEN_FDS_START)
+constexpr char LISTEN_PID_ENV[] = "LISTEN_PID";
+constexpr char LISTEN_FDS_ENV[] = "LISTEN_FDS";
+constexpr char LISTEN_FDNAMES_ENV[] = "LISTEN_FDNAMES";
+constexpr int LISTEN_FDS_START = 3;
+
+// The listening control socket whoever started us opened on our behalf,
+// with systemd's socket activation protocol: LISTEN_FDS descriptors from
+// fd 3 on, meant for the process LISTEN_PID names. The variables are
+// removed so children don't take them for theirs. Returns -1 when we
+// weren't socket activated, or on Windows.
+qintptr takeActivatedSocket();
+
+} // namespace DiscordDrawRPC
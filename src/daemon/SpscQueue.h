@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Bounded lock-free queue for exactly one producer and one consumer thread.
+ * Each side owns one index and only reads the other's, so a push or pop is
+ * a couple of atomic loads and one release store. Slots are reused; popping
+ * moves the value out and leaves a moved-from object behind.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    
+public:
+    SpscQueue() : m_head(0), m_tail(0) {}
+    
+    // Producer only, false when full
+    bool tryPush(T value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_slots[tail & (Capacity - 1)] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer only, false when empty
+    bool tryPop(T& out) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = std::move(m_slots[head & (Capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+private:
+    std::array<T, Capacity> m_slots;
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+};
+
+} // namespace DiscordDrawRPC
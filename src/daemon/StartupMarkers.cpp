@@ -0,0 +1,29 @@
+#include "StartupMarkers.h"
+#include <QtGlobal>
+#include <QSet>
+#include <QByteArray>
+#include <chrono>
+#include <cstdio>
+
+namespace DiscordDrawRPC {
+
+void markStartup(const char* phase) {
+    static const bool enabled = qEnvironmentVariableIsSet(STARTUP_MARKERS_ENV);
+    if (!enabled) {
+        return;
+    }
+    
+    static QSet<QByteArray> reached;
+    if (reached.contains(phase)) {
+        return;
+    }
+    reached.insert(phase);
+    
+    // Wall clock so the launching process can compare against its own
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::fprintf(stderr, "startup-marker %s %lld\n", phase, static_cast<long long>(micros));
+    std::fflush(stderr);
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace DiscordDrawRPC {
+
+// Environment variable that turns startup markers on
+constexpr char STARTUP_MARKERS_ENV[] = "DISCORD_DRAW_RPC_STARTUP_MARKERS";
+
+// Note that startup reached a phase: with STARTUP_MARKERS_ENV set, writes
+// "startup-marker <phase> <unix time in µs>" to stderr the first time each
+// phase is reached. The line bypasses the async logger so it isn't delayed
+// by batching. Costs a branch otherwise. Main thread only.
+void markStartup(const char* phase);
+
+} // namespace DiscordDrawRPC
@@ -1,97 +1,96 @@
 #include <QCoreApplication>
+#include <QCommandLineParser>
 #include <QDebug>
-#include <QFile>
-#include <QTextStream>
-#include <QDateTime>
-#include <QMutex>
 #include "DiscordRPCDaemon.h"
+#include "AsyncLogger.h"
+#include "LogCategories.h"
+#include "ServiceNotify.h"
+#include "StartupMarkers.h"
 #include "../common/Config.h"
 #include "../common/PlatformUtils.h"
 
-// Global file for logging
-static QFile* g_logFile = nullptr;
-static QMutex g_logMutex;
+// Writes to both console and file from a background thread
+static DiscordDrawRPC::AsyncLogger* g_logger = nullptr;
 
-// Custom message handler to write to both console and file
+// Custom message handler, only queues the message for the logger thread
 void messageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg) {
-    QMutexLocker locker(&g_logMutex);
-    
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    QString typeStr;
-    
-    switch (type) {
-        case QtDebugMsg:
-            typeStr = "DEBUG";
-            break;
-        case QtInfoMsg:
-            typeStr = "INFO";
-            break;
-        case QtWarningMsg:
-            typeStr = "WARNING";
-            break;
-        case QtCriticalMsg:
-            typeStr = "CRITICAL";
-            break;
-        case QtFatalMsg:
-            typeStr = "FATAL";
-            break;
-    }
-    
-    QString formattedMsg = QString("[%1] [%2] %3").arg(timestamp, typeStr, msg);
-    
-    // Write to console
-    fprintf(stderr, "%s\n", formattedMsg.toLocal8Bit().constData());
-    
-    // Write to log file
-    if (g_logFile && g_logFile->isOpen()) {
-        QTextStream stream(g_logFile);
-        stream << formattedMsg << "\n";
-        stream.flush();
-    }
+    g_logger->log(type, context.category, msg);
     
     if (type == QtFatalMsg) {
+        // Get the reason on disk before going down
+        g_logger->stop();
         abort();
     }
 }
 
 int main(int argc, char *argv[]) {
+    DiscordDrawRPC::markStartup("main");
+    
     QCoreApplication app(argc, argv);
     app.setApplicationName("DiscordDrawingRPC");
     app.setOrganizationName("TheGameratorT");
     
-    // Check if another instance is already running
-    if (DiscordDrawRPC::ProcessUtils::isDaemonRunning()) {
-        qCritical() << "Discord Drawing RPC Daemon is already running.";
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Discord Drawing RPC Daemon");
+    parser.addHelpOption();
+    QCommandLineOption metricsFileOption("metrics-file",
+        "Periodically write metrics in Prometheus text format to <file>.", "file");
+    parser.addOption(metricsFileOption);
+    parser.process(app);
+    
+    // Holding the PID file's lock is what marks this instance as running
+    QString pidFile = DiscordDrawRPC::Config::instance().getDaemonPidFilePath();
+    if (!DiscordDrawRPC::ProcessUtils::lockPidFile(pidFile, QCoreApplication::applicationPid())) {
+        qCCritical(DiscordDrawRPC::lcDaemonLifecycle) << "Discord Drawing RPC Daemon is already running.";
         return 1;
     }
+    DiscordDrawRPC::markStartup("pid_locked");
     
     // Setup logging to file
     DiscordDrawRPC::Config& config = DiscordDrawRPC::Config::instance();
     if (!config.load()) {
-        qWarning() << "Failed to load configuration, using defaults";
+        qCWarning(DiscordDrawRPC::lcDaemonLifecycle) << "Failed to load configuration, using defaults";
     }
+    config.watchForChanges();
+    DiscordDrawRPC::markStartup("config_loaded");
     
     QString logPath = config.getLogFilePath();
-    g_logFile = new QFile(logPath);
-    if (g_logFile->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+    g_logger = new DiscordDrawRPC::AsyncLogger;
+    DiscordDrawRPC::applyLogLevels(config.logLevels());
+    g_logger->setRotation(qint64(config.logMaxSizeMb()) * 1024 * 1024, config.logMaxFiles());
+    if (g_logger->open(logPath)) {
+        g_logger->start();
         qInstallMessageHandler(messageHandler);
-        qInfo() << "===== Daemon Starting =====";
+        qCInfo(DiscordDrawRPC::lcDaemonLifecycle) << "===== Daemon Starting =====";
     } else {
-        qWarning() << "Failed to open log file:" << logPath;
+        qCWarning(DiscordDrawRPC::lcDaemonLifecycle) << "Failed to open log file:" << logPath;
+        delete g_logger;
+        g_logger = nullptr;
     }
+    DiscordDrawRPC::markStartup("logger_started");
+    
+    // The rotation limits follow config.json, the daemon applies the rest
+    QObject::connect(&config, &DiscordDrawRPC::Config::changed, [&config]() {
+        if (g_logger) {
+            g_logger->setRotation(qint64(config.logMaxSizeMb()) * 1024 * 1024, config.logMaxFiles());
+        }
+    });
     
     // Create and start daemon
     DiscordDrawRPC::DiscordRPCDaemon daemon;
+    daemon.setMetricsFile(parser.value(metricsFileOption));
     daemon.start();
     
     int result = app.exec();
+    DiscordDrawRPC::notifyService(DiscordDrawRPC::NOTIFY_STOPPING);
     
     // Cleanup
-    qInfo() << "===== Daemon Shutting Down =====";
-    if (g_logFile) {
-        g_logFile->close();
-        delete g_logFile;
-        g_logFile = nullptr;
+    qCInfo(DiscordDrawRPC::lcDaemonLifecycle) << "===== Daemon Shutting Down =====";
+    if (g_logger) {
+        qInstallMessageHandler(nullptr);
+        g_logger->stop();
+        delete g_logger;
+        g_logger = nullptr;
     }
     
     return result;
@@ -0,0 +1,450 @@
+#include "LogModel.h"
+#include <QtConcurrent>
+#include <QByteArrayMatcher>
+#include <QColor>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+
+namespace DiscordDrawRPC {
+
+static constexpr quint32 ALL_LEVELS = (1u << LogModel::LevelCount) - 1;
+// Bytes compared to tell an appended file from a rotated or rewritten one
+static constexpr int HEAD_SIGNATURE_SIZE = 64;
+// Below these a chunk isn't worth a thread pool task
+static constexpr qint64 MIN_INDEX_CHUNK_BYTES = 1024 * 1024;
+static constexpr int MIN_SEARCH_CHUNK_LINES = 16384;
+// Lines are written as "[yyyy-MM-dd HH:mm:ss] [LEVEL] message"
+static constexpr int LEVEL_TAG_OFFSET = 22;
+
+LogModel::LogModel(QObject* parent)
+    : QAbstractListModel(parent)
+    , m_indexWatcher(new QFutureWatcher<IndexChunk>(this))
+    , m_refreshPending(false)
+    , m_visibleLevels(ALL_LEVELS)
+    , m_searchWatcher(new QFutureWatcher<QVector<int>>(this))
+{
+    connect(m_indexWatcher, &QFutureWatcher<IndexChunk>::finished, this, &LogModel::onIndexingFinished);
+    connect(m_searchWatcher, &QFutureWatcher<QVector<int>>::finished, this, &LogModel::onSearchFinished);
+}
+
+LogModel::~LogModel() {
+    // Running tasks hold their own reference to the mapping
+    m_indexWatcher->cancel();
+    m_searchWatcher->cancel();
+}
+
+std::shared_ptr<LogModel::Mapping> LogModel::map(const QString& path) {
+    auto mapping = std::make_shared<Mapping>();
+    mapping->file.setFileName(path);
+    if (!mapping->file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    
+    // An empty file can't be mapped, it simply has no lines yet
+    mapping->size = mapping->file.size();
+    if (mapping->size > 0) {
+        mapping->data = reinterpret_cast<const char*>(mapping->file.map(0, mapping->size));
+        if (!mapping->data) {
+            return nullptr;
+        }
+    }
+    return mapping;
+}
+
+bool LogModel::open(const QString& path) {
+    close();
+    
+    std::shared_ptr<Mapping> mapping = map(path);
+    if (!mapping) {
+        return false;
+    }
+    
+    beginResetModel();
+    m_path = path;
+    m_mapping = mapping;
+    m_head = QByteArray(mapping->data, qMin<qint64>(mapping->size, HEAD_SIGNATURE_SIZE));
+    m_lineStarts = { 0 };
+    m_levels = { Info };
+    m_rows.clear();
+    endResetModel();
+    
+    startIndexing();
+    return true;
+}
+
+void LogModel::close() {
+    m_indexWatcher->cancel();
+    m_searchWatcher->cancel();
+    m_refreshPending = false;
+    
+    beginResetModel();
+    m_mapping.reset();
+    m_lineStarts.clear();
+    m_levels.clear();
+    m_head.clear();
+    m_rows.clear();
+    m_matches.clear();
+    endResetModel();
+}
+
+void LogModel::refresh() {
+    if (!m_mapping) {
+        return;
+    }
+    
+    // Appended lines are picked up once the running pass is done
+    if (m_indexWatcher->isRunning()) {
+        m_refreshPending = true;
+        return;
+    }
+    
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    
+    qint64 size = file.size();
+    if (size < m_mapping->size || file.read(m_head.size()) != m_head) {
+        open(m_path);
+        return;
+    }
+    
+    if (size == m_mapping->size) {
+        return;
+    }
+    
+    // The new mapping covers the old bytes too, rows already indexed stay valid
+    std::shared_ptr<Mapping> mapping = map(m_path);
+    if (mapping) {
+        m_mapping = mapping;
+        startIndexing();
+    }
+}
+
+quint8 LogModel::parseLevel(const char* line, const char* end) {
+    if (end - line < LEVEL_TAG_OFFSET + 2 || line[0] != '[' || line[LEVEL_TAG_OFFSET] != '[') {
+        return LevelCount;
+    }
+    
+    switch (line[LEVEL_TAG_OFFSET + 1]) {
+        case 'D':
+            return Debug;
+        case 'I':
+            return Info;
+        case 'W':
+            return Warning;
+        case 'C':
+        case 'F':
+            return Critical;
+    }
+    return LevelCount;
+}
+
+LogModel::IndexChunk LogModel::indexChunk(const Mapping& mapping, IndexChunk chunk) {
+    const char* data = mapping.data;
+    const char* end = data + mapping.size;
+    const char* pos = data + chunk.begin;
+    const char* chunkEnd = data + chunk.end;
+    
+    // Every newline starts the next line, the one after the last is unfinished
+    while (pos < chunkEnd) {
+        const char* newline = static_cast<const char*>(std::memchr(pos, '\n', chunkEnd - pos));
+        if (!newline) {
+            break;
+        }
+        pos = newline + 1;
+        chunk.starts.append(pos - data);
+        chunk.levels.append(parseLevel(pos, end));
+    }
+    return chunk;
+}
+
+void LogModel::startIndexing() {
+    qint64 begin = m_lineStarts.last();
+    qint64 bytes = m_mapping->size - begin;
+    if (bytes <= 0) {
+        return;
+    }
+    
+    int count = int(qBound<qint64>(1, bytes / MIN_INDEX_CHUNK_BYTES, QThread::idealThreadCount() * 4));
+    QVector<IndexChunk> chunks;
+    for (int i = 0; i < count; ++i) {
+        IndexChunk chunk;
+        chunk.begin = begin + bytes * i / count;
+        chunk.end = begin + bytes * (i + 1) / count;
+        chunks.append(chunk);
+    }
+    
+    std::shared_ptr<Mapping> mapping = m_mapping;
+    m_indexWatcher->setFuture(QtConcurrent::mapped(chunks, [mapping](const IndexChunk& chunk) {
+        return indexChunk(*mapping, chunk);
+    }));
+}
+
+void LogModel::onIndexingFinished() {
+    if (!m_mapping || m_indexWatcher->isCanceled()) {
+        return;
+    }
+    
+    const QList<IndexChunk> chunks = m_indexWatcher->future().results();
+    int firstLine = lineCount();
+    
+    // The line that was unfinished may have been cut short when it was parsed
+    quint8 firstLevel = parseLevel(m_mapping->data + m_lineStarts.last(), m_mapping->data + m_mapping->size);
+    QVector<qint64> starts;
+    QVector<quint8> levels;
+    for (const IndexChunk& chunk : chunks) {
+        starts += chunk.starts;
+        levels += chunk.levels;
+    }
+    
+    // Continuation lines belong to the message before them
+    quint8 previous = firstLine > 0 ? m_levels[firstLine - 1] : quint8(Info);
+    if (firstLevel == LevelCount) {
+        firstLevel = previous;
+    }
+    previous = firstLevel;
+    for (quint8& level : levels) {
+        if (level == LevelCount) {
+            level = previous;
+        }
+        previous = level;
+    }
+    
+    // Only lines ending in a newline become rows
+    int newLines = starts.size();
+    QVector<int> newRows;
+    if (m_visibleLevels != ALL_LEVELS) {
+        for (int i = 0; i < newLines; ++i) {
+            if (isLevelVisible(Level(i == 0 ? firstLevel : levels[i - 1]))) {
+                newRows.append(firstLine + i);
+            }
+        }
+    }
+    
+    int inserted = m_visibleLevels != ALL_LEVELS ? newRows.size() : newLines;
+    if (inserted > 0) {
+        beginInsertRows(QModelIndex(), rowCount(), rowCount() + inserted - 1);
+    }
+    m_levels.last() = firstLevel;
+    m_lineStarts += starts;
+    m_levels += levels;
+    m_rows += newRows;
+    if (inserted > 0) {
+        endInsertRows();
+    }
+    
+    emit indexingFinished();
+    
+    if (m_refreshPending) {
+        m_refreshPending = false;
+        refresh();
+    }
+}
+
+void LogModel::setLevelVisible(Level level, bool visible) {
+    quint32 levels = visible ? m_visibleLevels | (1u << level) : m_visibleLevels & ~(1u << level);
+    if (levels != m_visibleLevels) {
+        m_visibleLevels = levels;
+        rebuildRows();
+    }
+}
+
+void LogModel::rebuildRows() {
+    beginResetModel();
+    m_rows.clear();
+    if (m_visibleLevels != ALL_LEVELS) {
+        int lines = lineCount();
+        for (int line = 0; line < lines; ++line) {
+            if (isLevelVisible(Level(m_levels[line]))) {
+                m_rows.append(line);
+            }
+        }
+    }
+    endResetModel();
+}
+
+int LogModel::rowToLine(int row) const {
+    return m_visibleLevels != ALL_LEVELS ? m_rows[row] : row;
+}
+
+int LogModel::lineToRow(int line) const {
+    if (m_visibleLevels == ALL_LEVELS) {
+        return line;
+    }
+    auto it = std::lower_bound(m_rows.begin(), m_rows.end(), line);
+    return it != m_rows.end() && *it == line ? int(it - m_rows.begin()) : -1;
+}
+
+QVector<int> LogModel::searchChunk(const Mapping& mapping, const QVector<qint64>& lineStarts, SearchChunk chunk,
+                                   const QByteArray& needle, const QRegularExpression& expression) {
+    QVector<int> matches;
+    
+    if (!needle.isEmpty()) {
+        // Plain text is matched on the raw bytes, only hits get mapped to lines
+        QByteArrayMatcher matcher(needle);
+        const char* base = mapping.data + lineStarts[chunk.firstLine];
+        qsizetype length = lineStarts[chunk.lastLine] - lineStarts[chunk.firstLine];
+        qsizetype from = 0;
+        
+        for (;;) {
+            qsizetype hit = matcher.indexIn(base, length, from);
+            if (hit < 0) {
+                break;
+            }
+            
+            qint64 offset = lineStarts[chunk.firstLine] + hit;
+            auto next = std::upper_bound(lineStarts.begin() + chunk.firstLine, lineStarts.begin() + chunk.lastLine, offset);
+            int line = int(next - lineStarts.begin()) - 1;
+            matches.append(line);
+            from = lineStarts[line + 1] - lineStarts[chunk.firstLine];
+        }
+        return matches;
+    }
+    
+    for (int line = chunk.firstLine; line < chunk.lastLine; ++line) {
+        const char* begin = mapping.data + lineStarts[line];
+        qsizetype length = lineStarts[line + 1] - lineStarts[line] - 1;
+        if (expression.match(QString::fromUtf8(begin, length)).hasMatch()) {
+            matches.append(line);
+        }
+    }
+    return matches;
+}
+
+void LogModel::search(const QString& pattern, bool regex, Qt::CaseSensitivity sensitivity) {
+    clearSearch();
+    
+    QRegularExpression expression(regex ? pattern : QRegularExpression::escape(pattern),
+                                  sensitivity == Qt::CaseInsensitive ? QRegularExpression::CaseInsensitiveOption
+                                                                     : QRegularExpression::NoPatternOption);
+    if (pattern.isEmpty() || !expression.isValid() || lineCount() == 0) {
+        emit searchFinished();
+        return;
+    }
+    expression.optimize();
+    
+    // Case-sensitive substrings don't need the lines decoded
+    QByteArray needle = !regex && sensitivity == Qt::CaseSensitive ? pattern.toUtf8() : QByteArray();
+    
+    int lines = lineCount();
+    int chunkLines = qMax(MIN_SEARCH_CHUNK_LINES, lines / (QThread::idealThreadCount() * 4) + 1);
+    QVector<SearchChunk> chunks;
+    for (int first = 0; first < lines; first += chunkLines) {
+        chunks.append({ first, qMin(first + chunkLines, lines) });
+    }
+    
+    // The tasks work on a snapshot, lines indexed meanwhile aren't searched
+    std::shared_ptr<Mapping> mapping = m_mapping;
+    QVector<qint64> lineStarts = m_lineStarts;
+    m_searchWatcher->setFuture(QtConcurrent::mapped(chunks, [=](const SearchChunk& chunk) {
+        return searchChunk(*mapping, lineStarts, chunk, needle, expression);
+    }));
+}
+
+void LogModel::onSearchFinished() {
+    if (m_searchWatcher->isCanceled()) {
+        return;
+    }
+    
+    // Chunks come back in order, so the matches stay sorted
+    m_matches.clear();
+    for (const QVector<int>& matches : m_searchWatcher->future().results()) {
+        m_matches += matches;
+    }
+    
+    if (rowCount() > 0) {
+        emit dataChanged(index(0), index(rowCount() - 1), { Qt::BackgroundRole });
+    }
+    emit searchFinished();
+}
+
+void LogModel::clearSearch() {
+    m_searchWatcher->cancel();
+    if (m_matches.isEmpty()) {
+        return;
+    }
+    
+    m_matches.clear();
+    if (rowCount() > 0) {
+        emit dataChanged(index(0), index(rowCount() - 1), { Qt::BackgroundRole });
+    }
+}
+
+int LogModel::matchCount() const {
+    if (m_visibleLevels == ALL_LEVELS) {
+        return m_matches.size();
+    }
+    return int(std::count_if(m_matches.begin(), m_matches.end(), [this](int line) {
+        return isLevelVisible(Level(m_levels[line]));
+    }));
+}
+
+int LogModel::nextMatch(int row, bool backward) const {
+    int line = row < 0 ? -1 : row >= rowCount() ? lineCount() : rowToLine(row);
+    
+    if (!backward) {
+        for (auto it = std::upper_bound(m_matches.begin(), m_matches.end(), line); it != m_matches.end(); ++it) {
+            int match = lineToRow(*it);
+            if (match >= 0) {
+                return match;
+            }
+        }
+    } else {
+        for (auto it = std::lower_bound(m_matches.begin(), m_matches.end(), line); it != m_matches.begin();) {
+            int match = lineToRow(*--it);
+            if (match >= 0) {
+                return match;
+            }
+        }
+    }
+    return -1;
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_visibleLevels != ALL_LEVELS ? int(m_rows.size()) : lineCount();
+}
+
+QVariant LogModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || !m_mapping || index.row() >= rowCount()) {
+        return QVariant();
+    }
+    
+    int line = rowToLine(index.row());
+    
+    switch (role) {
+        case Qt::DisplayRole: {
+            // Rows are only decoded when the view draws them
+            const char* begin = m_mapping->data + m_lineStarts[line];
+            const char* end = m_mapping->data + m_lineStarts[line + 1] - 1;
+            if (end > begin && end[-1] == '\r') {
+                --end;
+            }
+            return QString::fromUtf8(begin, end - begin);
+        }
+        case Qt::ForegroundRole:
+            switch (m_levels[line]) {
+                case Debug:
+                    return QColor("#808080");
+                case Warning:
+                    return QColor("#E5C07B");
+                case Critical:
+                    return QColor("#F14C4C");
+            }
+            return QVariant();
+        case Qt::BackgroundRole:
+            if (std::binary_search(m_matches.begin(), m_matches.end(), line)) {
+                return QColor("#264F78");
+            }
+            return QVariant();
+        case LevelRole:
+            return int(m_levels[line]);
+    }
+    return QVariant();
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QString>
+#include <QByteArray>
+#include <QRegularExpression>
+#include <QVector>
+#include <memory>
+
+namespace DiscordDrawRPC {
+
+/**
+ * List model over the daemon's log file that never materializes its text.
+ * The file is memory-mapped and a line-offset index is built in parallel
+ * chunks on the thread pool; rows are decoded only when the view asks for
+ * them. Appended lines are indexed incrementally by refresh(), a shrunk or
+ * replaced (rotated) file is reopened from scratch.
+ * 
+ * The mapping must not be truncated under the model, reading past the new
+ * end of file would fault. The daemon only ever appends and rotates by
+ * renaming, and clearing from the GUI closes the model first.
+ */
+class LogModel : public QAbstractListModel {
+    Q_OBJECT
+    
+public:
+    // Continuation lines take the level of the line they follow
+    enum Level : quint8 {
+        Debug,
+        Info,
+        Warning,
+        Critical,
+        LevelCount
+    };
+    
+    enum Role {
+        LevelRole = Qt::UserRole + 1
+    };
+    
+    explicit LogModel(QObject* parent = nullptr);
+    ~LogModel();
+    
+    // Map the file and start indexing it, rows show up once indexed
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_mapping != nullptr; }
+    // Index lines appended since the last call, reopen if the file was replaced
+    void refresh();
+    
+    void setLevelVisible(Level level, bool visible);
+    bool isLevelVisible(Level level) const { return m_visibleLevels & (1u << level); }
+    
+    // Find the lines matching a substring or regular expression in the background
+    void search(const QString& pattern, bool regex, Qt::CaseSensitivity sensitivity);
+    void clearSearch();
+    int matchCount() const;
+    // Next visible row with a match after (or before) the given one, -1 if none
+    int nextMatch(int row, bool backward) const;
+    
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    
+signals:
+    void indexingFinished();
+    void searchFinished();
+    
+private:
+    struct Mapping {
+        QFile file;
+        const char* data = nullptr;
+        qint64 size = 0;
+    };
+    
+    struct IndexChunk {
+        qint64 begin;
+        qint64 end;
+        QVector<qint64> starts;
+        QVector<quint8> levels;
+    };
+    
+    struct SearchChunk {
+        int firstLine;
+        int lastLine;
+    };
+    
+    static std::shared_ptr<Mapping> map(const QString& path);
+    static quint8 parseLevel(const char* line, const char* end);
+    static IndexChunk indexChunk(const Mapping& mapping, IndexChunk chunk);
+    static QVector<int> searchChunk(const Mapping& mapping, const QVector<qint64>& lineStarts, SearchChunk chunk,
+                                    const QByteArray& needle, const QRegularExpression& expression);
+    
+    void startIndexing();
+    void onIndexingFinished();
+    void onSearchFinished();
+    void rebuildRows();
+    int lineToRow(int line) const;
+    int rowToLine(int row) const;
+    int lineCount() const { return m_lineStarts.isEmpty() ? 0 : int(m_lineStarts.size()) - 1; }
+    
+    QString m_path;
+    std::shared_ptr<Mapping> m_mapping;
+    // Offsets of every complete line, followed by the offset of the next one
+    QVector<qint64> m_lineStarts;
+    QVector<quint8> m_levels;
+    QByteArray m_head;
+    
+    QFutureWatcher<IndexChunk>* m_indexWatcher;
+    bool m_refreshPending;
+    
+    // Visible lines when some levels are filtered out, all lines otherwise
+    quint32 m_visibleLevels;
+    QVector<int> m_rows;
+    
+    QFutureWatcher<QVector<int>>* m_searchWatcher;
+    QVector<int> m_matches;
+};
+
+} // namespace DiscordDrawRPC
@@ -3,27 +3,78 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFile>
-#include <QTextStream>
 #include <QScrollBar>
-#include <QFileInfo>
 
 namespace DiscordDrawRPC {
 
 LogViewerDialog::LogViewerDialog(QWidget* parent)
     : QDialog(parent)
-    , m_lastFileSize(0)
+    , m_followTail(true)
 {
     setWindowTitle("Presence Logs");
     setMinimumSize(800, 600);
     
+    m_model = new LogModel(this);
+    
     // Main layout
     QVBoxLayout* mainLayout = new QVBoxLayout(this);
     
-    // Log view
-    m_logView = new QTextEdit(this);
-    m_logView->setReadOnly(true);
+    // Filter and search bar
+    QHBoxLayout* filterLayout = new QHBoxLayout();
+    
+    addLevelFilter(filterLayout, "Debug", LogModel::Debug);
+    addLevelFilter(filterLayout, "Info", LogModel::Info);
+    addLevelFilter(filterLayout, "Warning", LogModel::Warning);
+    addLevelFilter(filterLayout, "Error", LogModel::Critical);
+    
+    filterLayout->addStretch();
+    
+    m_searchInput = new QLineEdit(this);
+    m_searchInput->setPlaceholderText("Search logs...");
+    m_searchInput->setClearButtonEnabled(true);
+    m_searchInput->setMinimumWidth(250);
+    filterLayout->addWidget(m_searchInput);
+    
+    m_regexCheckbox = new QCheckBox("Regex", this);
+    filterLayout->addWidget(m_regexCheckbox);
+    
+    m_matchCaseCheckbox = new QCheckBox("Match case", this);
+    filterLayout->addWidget(m_matchCaseCheckbox);
+    
+    QPushButton* prevBtn = new QPushButton("▲", this);
+    prevBtn->setToolTip("Previous match");
+    connect(prevBtn, &QPushButton::clicked, this, &LogViewerDialog::findPrevious);
+    filterLayout->addWidget(prevBtn);
+    
+    QPushButton* nextBtn = new QPushButton("▼", this);
+    nextBtn->setToolTip("Next match");
+    connect(nextBtn, &QPushButton::clicked, this, &LogViewerDialog::findNext);
+    filterLayout->addWidget(nextBtn);
+    
+    m_matchLabel = new QLabel(this);
+    m_matchLabel->setMinimumWidth(80);
+    filterLayout->addWidget(m_matchLabel);
+    
+    mainLayout->addLayout(filterLayout);
+    
+    // Search once typing pauses, a scan over a large log isn't free
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(300);
+    connect(m_searchTimer, &QTimer::timeout, this, &LogViewerDialog::startSearch);
+    connect(m_searchInput, &QLineEdit::textChanged, m_searchTimer, qOverload<>(&QTimer::start));
+    connect(m_searchInput, &QLineEdit::returnPressed, this, &LogViewerDialog::findNext);
+    connect(m_regexCheckbox, &QCheckBox::toggled, this, &LogViewerDialog::startSearch);
+    connect(m_matchCaseCheckbox, &QCheckBox::toggled, this, &LogViewerDialog::startSearch);
+    connect(m_model, &LogModel::searchFinished, this, &LogViewerDialog::onSearchFinished);
+    
+    // Log view, only the rows on screen are ever decoded
+    m_logView = new QListView(this);
+    m_logView->setModel(m_model);
+    m_logView->setUniformItemSizes(true);
+    m_logView->setSelectionMode(QAbstractItemView::SingleSelection);
     m_logView->setStyleSheet(
-        "QTextEdit {"
+        "QListView {"
         "    font-family: 'Consolas', 'Courier New', monospace;"
         "    font-size: 10pt;"
         "    background-color: #1e1e1e;"
@@ -33,9 +84,22 @@ LogViewerDialog::LogViewerDialog(QWidget* parent)
     );
     mainLayout->addWidget(m_logView);
     
+    // Keep following the end of the log while it's scrolled there
+    connect(m_model, &QAbstractItemModel::rowsAboutToBeInserted, this, [this]() {
+        QScrollBar* scrollBar = m_logView->verticalScrollBar();
+        m_followTail = scrollBar->value() == scrollBar->maximum();
+    });
+    connect(m_model, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (m_followTail) {
+            m_logView->scrollToBottom();
+        }
+    });
+    
     // Button layout
     QHBoxLayout* btnLayout = new QHBoxLayout();
     
+    m_statusLabel = new QLabel(this);
+    
     m_refreshBtn = new QPushButton("🔄 Refresh", this);
     connect(m_refreshBtn, &QPushButton::clicked, this, &LogViewerDialog::refreshLogs);
     m_refreshBtn->setStyleSheet(
@@ -68,6 +132,7 @@ LogViewerDialog::LogViewerDialog(QWidget* parent)
     );
     btnLayout->addWidget(m_clearBtn);
     
+    btnLayout->addWidget(m_statusLabel);
     btnLayout->addStretch();
     
     m_closeBtn = new QPushButton("Close", this);
@@ -113,62 +178,89 @@ LogViewerDialog::~LogViewerDialog() {
 void LogViewerDialog::loadLogs() {
     QString logPath = Config::instance().getLogFilePath();
     
-    QFile logFile(logPath);
-    if (!logFile.exists()) {
-        m_logView->setPlainText("No log file found. Start the presence to generate logs.");
+    if (!QFile::exists(logPath)) {
+        if (m_model->isOpen()) {
+            m_model->close();
+        }
+        m_statusLabel->setText("No log file found. Start the presence to generate logs.");
         return;
     }
     
-    QFileInfo fileInfo(logFile);
-    qint64 currentSize = fileInfo.size();
-    
-    // Only update if file size changed
-    if (currentSize == m_lastFileSize) {
+    if (m_model->isOpen()) {
+        m_model->refresh();
         return;
     }
     
-    m_lastFileSize = currentSize;
-    
-    if (!logFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        m_logView->setPlainText("Error: Cannot open log file for reading.");
+    if (!m_model->open(logPath)) {
+        m_statusLabel->setText("Error: Cannot open log file for reading.");
         return;
     }
+    m_statusLabel->clear();
+}
+
+void LogViewerDialog::refreshLogs() {
+    // Force reload
+    m_model->close();
+    loadLogs();
+}
+
+void LogViewerDialog::addLevelFilter(QLayout* layout, const QString& label, LogModel::Level level) {
+    QCheckBox* checkbox = new QCheckBox(label, this);
+    checkbox->setChecked(true);
+    connect(checkbox, &QCheckBox::toggled, this, [this, level](bool checked) {
+        m_model->setLevelVisible(level, checked);
+        updateMatchLabel();
+    });
+    layout->addWidget(checkbox);
+}
+
+void LogViewerDialog::startSearch() {
+    m_searchTimer->stop();
+    m_matchLabel->clear();
     
-    // Read the last 10000 lines to avoid memory issues
-    QTextStream in(&logFile);
-    QStringList lines;
-    
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        lines.append(line);
-        
-        // Keep only last 10000 lines
-        if (lines.size() > 10000) {
-            lines.removeFirst();
-        }
+    Qt::CaseSensitivity sensitivity = m_matchCaseCheckbox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    m_model->search(m_searchInput->text(), m_regexCheckbox->isChecked(), sensitivity);
+}
+
+void LogViewerDialog::onSearchFinished() {
+    updateMatchLabel();
+    if (m_model->matchCount() > 0) {
+        selectMatch(false);
     }
+}
+
+void LogViewerDialog::findNext() {
+    selectMatch(false);
+}
+
+void LogViewerDialog::findPrevious() {
+    selectMatch(true);
+}
+
+void LogViewerDialog::selectMatch(bool backward) {
+    int row = m_logView->currentIndex().isValid() ? m_logView->currentIndex().row() : -1;
+    int match = m_model->nextMatch(row, backward);
     
-    logFile.close();
-    
-    // Save scroll position
-    QScrollBar* scrollBar = m_logView->verticalScrollBar();
-    bool wasAtBottom = scrollBar->value() == scrollBar->maximum();
-    
-    // Update text
-    m_logView->setPlainText(lines.join("\n"));
+    // Wrap around at either end
+    if (match < 0) {
+        match = m_model->nextMatch(backward ? m_model->rowCount() : -1, backward);
+    }
     
-    // Auto-scroll to bottom if we were already at bottom
-    if (wasAtBottom) {
-        QTimer::singleShot(0, [this]() {
-            QScrollBar* scrollBar = m_logView->verticalScrollBar();
-            scrollBar->setValue(scrollBar->maximum());
-        });
+    if (match >= 0) {
+        QModelIndex index = m_model->index(match);
+        m_logView->setCurrentIndex(index);
+        m_logView->scrollTo(index, QAbstractItemView::PositionAtCenter);
     }
 }
 
-void LogViewerDialog::refreshLogs() {
-    m_lastFileSize = 0; // Force reload
-    loadLogs();
+void LogViewerDialog::updateMatchLabel() {
+    if (m_searchInput->text().isEmpty()) {
+        m_matchLabel->clear();
+        return;
+    }
+    
+    int count = m_model->matchCount();
+    m_matchLabel->setText(count == 1 ? "1 match" : QString("%1 matches").arg(count));
 }
 
 void LogViewerDialog::clearLogs() {
@@ -176,12 +268,15 @@ void LogViewerDialog::clearLogs() {
     
     QFile logFile(logPath);
     if (logFile.exists()) {
+        // The mapping has to go before the file shrinks under it
+        m_model->close();
         if (logFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
             logFile.close();
-            m_lastFileSize = 0;
-            m_logView->setPlainText("Logs cleared.");
+            m_model->open(logPath);
+            m_statusLabel->setText("Logs cleared.");
         } else {
-            m_logView->append("\nError: Cannot clear log file.");
+            loadLogs();
+            m_statusLabel->setText("Error: Cannot clear log file.");
         }
     }
 }
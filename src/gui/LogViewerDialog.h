@@ -1,10 +1,14 @@
 #pragma once
 
 #include <QDialog>
-#include <QTextEdit>
+#include <QListView>
 #include <QPushButton>
+#include <QCheckBox>
+#include <QLineEdit>
+#include <QLabel>
 #include <QTimer>
 #include <QFileSystemWatcher>
+#include "LogModel.h"
 
 namespace DiscordDrawRPC {
 
@@ -19,17 +23,33 @@ private slots:
     void refreshLogs();
     void clearLogs();
     void onLogFileChanged();
+    void startSearch();
+    void onSearchFinished();
+    void findNext();
+    void findPrevious();
     
 private:
     void loadLogs();
+    void addLevelFilter(QLayout* layout, const QString& label, LogModel::Level level);
+    void selectMatch(bool backward);
+    void updateMatchLabel();
     
-    QTextEdit* m_logView;
+    LogModel* m_model;
+    QListView* m_logView;
+    QLineEdit* m_searchInput;
+    QCheckBox* m_regexCheckbox;
+    QCheckBox* m_matchCaseCheckbox;
+    QLabel* m_matchLabel;
+    QLabel* m_statusLabel;
     QPushButton* m_refreshBtn;
     QPushButton* m_clearBtn;
     QPushButton* m_closeBtn;
     QTimer* m_refreshTimer;
+    QTimer* m_searchTimer;
     QFileSystemWatcher* m_fileWatcher;
-    qint64 m_lastFileSize;
+    
+    // Whether the view was scrolled to the end before new rows came in
+    bool m_followTail;
 };
 
 } // namespace DiscordDrawRPC
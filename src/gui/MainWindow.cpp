@@ -7,6 +7,9 @@
 #include "../common/Common.h"
 #include "../common/PlatformUtils.h"
 #include "../common/DaemonIPC.h"
+#include "../common/ProcessWatcher.h"
+#include "../common/DaemonStatusClient.h"
+#include "../common/DaemonLauncher.h"
 #include "Version.h"
 
 #ifdef _WIN32
@@ -34,7 +37,6 @@
 #include <QDateTime>
 #include <QApplication>
 #include <QCloseEvent>
-#include <QThread>
 
 namespace DiscordDrawRPC {
 
@@ -47,20 +49,22 @@ const QString DISCORD_GREEN = "#43B581";
 const QString DARK_BG = "#2b2b2b";
 const QString DARK_GRAY = "#4E5058";
 
+// How long the daemon gets to exit after a quit request
+const int DAEMON_STOP_TIMEOUT_MS = 5000;
+
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
     , m_selector(nullptr)
-    , m_daemonCheckTimer(nullptr)
+    , m_statusClient(nullptr)
+    , m_launcher(nullptr)
 {
     m_isWayland = detectWayland();
-    storeGuiPid();
     
     initUi();
     
-    // Start daemon status check timer
-    m_daemonCheckTimer = new QTimer(this);
-    connect(m_daemonCheckTimer, &QTimer::timeout, this, &MainWindow::updateDaemonStatus);
-    m_daemonCheckTimer->start(1000);
+    // The daemon pushes its status changes
+    m_statusClient = new DaemonStatusClient(this);
+    connect(m_statusClient, &DaemonStatusClient::statusChanged, this, &MainWindow::updateDaemonStatus);
     updateDaemonStatus();
     
     // Load current state
@@ -71,9 +75,8 @@ MainWindow::MainWindow(QWidget* parent)
     
     // Auto-start presence if enabled
     Config& config = Config::instance();
-    config.load();
-    bool autoStartPresence = config.getConfig().value("auto_start_presence").toBool();
-    QString clientId = config.getValue("discord_client_id");
+    bool autoStartPresence = config.autoStartPresence();
+    const QString& clientId = config.discordClientId();
     
     // Don't auto-start if tray is running (means GUI was already running)
     if (autoStartPresence && !clientId.isEmpty() && !ProcessUtils::isDaemonRunning() && !ProcessUtils::isTrayRunning()) {
@@ -82,9 +85,6 @@ MainWindow::MainWindow(QWidget* parent)
 }
 
 MainWindow::~MainWindow() {
-    if (m_daemonCheckTimer) {
-        m_daemonCheckTimer->stop();
-    }
 }
 
 bool MainWindow::detectWayland() {
@@ -93,16 +93,10 @@ bool MainWindow::detectWayland() {
     return !waylandDisplay.isEmpty() || sessionType == "wayland";
 }
 
-void MainWindow::storeGuiPid() {
-    QString pidFile = Config::instance().getGuiPidFilePath();
-    ProcessUtils::writePidFile(pidFile, QCoreApplication::applicationPid());
-}
-
 void MainWindow::initTrayIcon() {
     Config& config = Config::instance();
-    config.load();
     
-    bool enableTray = config.getConfig().value("enable_tray_icon").toBool();
+    bool enableTray = config.enableTrayIcon();
     if (!enableTray) {
         // Stop tray if running
         if (ProcessUtils::isTrayRunning()) {
@@ -136,8 +130,13 @@ void MainWindow::launchTrayProcess() {
 }
 
 void MainWindow::loadCurrentState() {
-    QJsonObject stateData = DaemonIPC::readCurrentState();
-    
+    // Asked for without blocking, a busy daemon would hold up the window
+    DaemonIPC::readCurrentState(this, [this](const QJsonObject& stateData) {
+        applyCurrentState(stateData);
+    });
+}
+
+void MainWindow::applyCurrentState(const QJsonObject& stateData) {
     // Don't load if state is empty
     if (stateData.isEmpty()) {
         return;
@@ -716,7 +715,7 @@ void MainWindow::uploadToImgur() {
     m_uploadBtn->setEnabled(false);
     
     Config& config = Config::instance();
-    QString imgurClientId = config.getValue("imgur_client_id");
+    QString imgurClientId = config.imgurClientId();
     
     if (imgurClientId.isEmpty()) {
         QMessageBox::warning(this, "No Imgur Client ID", "Please configure Imgur Client ID in Settings!");
@@ -804,11 +803,18 @@ void MainWindow::setStartTimeToNow() {
 }
 
 void MainWindow::updateDaemonStatus() {
-    if (ProcessUtils::isDaemonRunning()) {
+    const DaemonStatusClient::Status& status = m_statusClient->status();
+    
+    if (status.running && status.discordConnected) {
         m_daemonStatusLabel->setText("Status: Running ✅");
         m_daemonStatusLabel->setStyleSheet(QString("padding: 5px; font-weight: bold; color: %1;").arg(DISCORD_GREEN));
         m_startDaemonBtn->setEnabled(false);
         m_stopDaemonBtn->setEnabled(true);
+    } else if (status.running) {
+        m_daemonStatusLabel->setText("Status: Running, waiting for Discord ⏳");
+        m_daemonStatusLabel->setStyleSheet("padding: 5px; font-weight: bold; color: #FAA61A;");
+        m_startDaemonBtn->setEnabled(false);
+        m_stopDaemonBtn->setEnabled(true);
     } else {
         m_daemonStatusLabel->setText("Status: Stopped ⏸");
         m_daemonStatusLabel->setStyleSheet("padding: 5px; font-weight: bold; color: #999;");
@@ -818,15 +824,19 @@ void MainWindow::updateDaemonStatus() {
 }
 
 void MainWindow::startDaemon() {
+    if (m_launcher) {
+        // Already on its way
+        return;
+    }
+    
     if (ProcessUtils::isDaemonRunning()) {
         QMessageBox::information(this, "Already Running", "Presence is already running!");
         return;
     }
     
-    // Check if client ID is set
+    // Check if client ID is set, the config watcher keeps it current
     Config& config = Config::instance();
-    config.load();
-    QString clientId = config.getValue("discord_client_id");
+    const QString& clientId = config.discordClientId();
     
     if (clientId.isEmpty()) {
         QMessageBox::warning(
@@ -852,25 +862,26 @@ void MainWindow::startDaemon() {
     // This prevents the daemon from immediately quitting if command was "quit"
     DaemonIPC::setUpdateCommand();
     
-    QProcess* process = new QProcess(this);
-    
-#ifdef _WIN32
-    process->setCreateProcessArgumentsModifier([](QProcess::CreateProcessArguments* args) {
-        args->flags |= CREATE_NO_WINDOW;
+    // Awaited without blocking; the status client picks the daemon up on its own
+    m_launcher = new DaemonLauncher(this);
+    connect(m_launcher, &DaemonLauncher::ready, this, [this]() {
+        m_launcher->deleteLater();
+        m_launcher = nullptr;
     });
-#endif
-    
-    process->startDetached(daemonPath);
-    
-    // Wait a moment and check if it started
-    QTimer::singleShot(500, this, [this]() {
+    connect(m_launcher, &DaemonLauncher::failed, this, [this](const QString& reason) {
+        m_launcher->deleteLater();
+        m_launcher = nullptr;
         updateDaemonStatus();
-        // if (ProcessUtils::isDaemonRunning()) {
-        //     QMessageBox::information(this, "Success", "Presence started successfully!");
-        // } else {
-        //     QMessageBox::warning(this, "Warning", "Presence may have failed to start. Check if Discord is running.");
-        // }
+        QMessageBox::warning(this, "Presence Not Started", reason);
     });
+    
+    m_startDaemonBtn->setEnabled(false);
+    if (!m_launcher->start(daemonPath)) {
+        delete m_launcher;
+        m_launcher = nullptr;
+        updateDaemonStatus();
+        QMessageBox::critical(this, "Presence Not Started", QString("Could not start presence service:\n%1").arg(daemonPath));
+    }
 }
 
 void MainWindow::stopDaemon() {
@@ -879,16 +890,19 @@ void MainWindow::stopDaemon() {
         return;
     }
     
-    DaemonIPC::sendQuitCommand();
+    qint64 pid = ProcessUtils::readPidFile(Config::instance().getDaemonPidFilePath());
+    DaemonIPC::sendQuitCommand(this);
     
-    // Wait and check
-    QTimer::singleShot(1000, this, [this]() {
+    // Update as soon as the daemon is gone instead of guessing how long it takes
+    ProcessWatcher* watcher = new ProcessWatcher(pid, this);
+    watcher->setTimeout(DAEMON_STOP_TIMEOUT_MS);
+    connect(watcher, &ProcessWatcher::exited, this, [this, watcher]() {
+        watcher->deleteLater();
+        updateDaemonStatus();
+    });
+    connect(watcher, &ProcessWatcher::timedOut, this, [this, watcher]() {
+        watcher->deleteLater();
         updateDaemonStatus();
-        // if (!ProcessUtils::isDaemonRunning()) {
-        //     QMessageBox::information(this, "Success", "Presence stopped!");
-        // } else {
-        //     QMessageBox::warning(this, "Warning", "Presence may still be running.");
-        // }
     });
 }
 
@@ -915,45 +929,63 @@ void MainWindow::updateDiscordStatus() {
         
         if (reply == QMessageBox::Yes) {
             startDaemon();
-            // Wait for daemon to start (poll up to 2 seconds)
-            for (int i = 0; i < 20 && !ProcessUtils::isDaemonRunning(); ++i) {
-                QThread::msleep(100);
+            if (m_launcher) {
+                // Sent once the daemon can take it, the window stays responsive meanwhile
+                m_statusLabel->setText("⏳ Starting presence...");
+                m_updateBtn->setEnabled(false);
+                connect(m_launcher, &DaemonLauncher::ready, this, [this]() {
+                    m_updateBtn->setEnabled(true);
+                    updateDiscordStatus();
+                });
+                connect(m_launcher, &DaemonLauncher::failed, this, [this]() {
+                    m_updateBtn->setEnabled(true);
+                    m_statusLabel->setText("❌ Error: Presence did not start");
+                });
             }
+            return;
         }
     }
     
-    // Send update command
-    bool success = DaemonIPC::sendUpdateCommand(
+    // Send update command, the answer comes back without blocking the window
+    m_statusLabel->setText("⏳ Updating Discord status...");
+    m_updateBtn->setEnabled(false);
+    DaemonIPC::sendUpdateCommand(
         url,
         "Screenshot",
         details.isEmpty() ? "Sharing a screenshot" : details,
         state,
-        startTime
+        startTime,
+        this,
+        [this](bool success) {
+            m_updateBtn->setEnabled(true);
+            if (success) {
+                m_statusLabel->setText("✅ Discord status updated!");
+                QMessageBox::information(this, "Success", "Discord status updated!");
+            } else {
+                QMessageBox::critical(this, "Error", "Failed to update status!");
+                m_statusLabel->setText("❌ Error: Failed to write state file");
+            }
+        }
     );
-    
-    if (success) {
-        m_statusLabel->setText("✅ Discord status updated!");
-        QMessageBox::information(this, "Success", "Discord status updated!");
-    } else {
-        QMessageBox::critical(this, "Error", "Failed to update status!");
-        m_statusLabel->setText("❌ Error: Failed to write state file");
-    }
 }
 
 void MainWindow::quitApplication() {
-    // Stop daemon if running
-    if (ProcessUtils::isDaemonRunning()) {
-        stopDaemon();
-    }
-    
     // Stop tray if running
     if (ProcessUtils::isTrayRunning()) {
         ProcessUtils::terminateProcessFromPidFile(Config::instance().getTrayPidFilePath());
     }
     
-    // Clean up PID file
-    QString guiPidFile = Config::instance().getGuiPidFilePath();
-    QFile::remove(guiPidFile);
+    // Release PID file
+    ProcessUtils::unlockPidFile(Config::instance().getGuiPidFilePath());
+    
+    // Stop daemon if running, quitting once it has the request
+    if (ProcessUtils::isDaemonRunning()) {
+        hide();
+        DaemonIPC::sendQuitCommand(this, [](bool) {
+            QApplication::quit();
+        });
+        return;
+    }
     
     QApplication::quit();
 }
@@ -977,26 +1009,22 @@ void MainWindow::showSettings() {
         // Save settings
         Config& config = Config::instance();
         
-        // Check if Discord Client ID changed
-        QString oldClientId = config.getValue("discord_client_id");
-        QString newClientId = settings.value("discord_client_id").toString();
-        bool clientIdChanged = (oldClientId != newClientId);
-        
-        config.setConfig(settings);
+        // Only overwrite the keys the dialog edits, keep the advanced ones
+        QJsonObject merged = config.getConfig();
+        for (auto it = settings.constBegin(); it != settings.constEnd(); ++it) {
+            merged[it.key()] = it.value();
+        }
+        config.setConfig(merged);
         
         if (config.save()) {
             // Re-initialize tray icon based on new setting
             initTrayIcon();
             
-            QString message = "Settings saved successfully!";
-            if (clientIdChanged) {
-                message += "\n\nPlease restart the presence for changes to take effect.";
-            }
-            
+            // A running presence picks up a new Discord Client ID by itself
             QMessageBox::information(
                 this,
                 "Settings Saved",
-                message
+                "Settings saved successfully!"
             );
         } else {
             QMessageBox::critical(
@@ -1029,23 +1057,24 @@ void MainWindow::showAbout() {
 }
 
 void MainWindow::closeEvent(QCloseEvent* event) {
-    if (m_daemonCheckTimer) {
-        m_daemonCheckTimer->stop();
-    }
-    
     // Check config option for stopping daemon on close
     Config& config = Config::instance();
-    config.load();
-    bool stopDaemonOnClose = config.getConfig().value("stop_daemon_on_close").toBool();
+    bool stopDaemonOnClose = config.stopDaemonOnClose();
     
+    // Release PID file
+    ProcessUtils::unlockPidFile(Config::instance().getGuiPidFilePath());
+    
+    // Closing the last window would quit before the request got out, so
+    // the window only hides and the application quits once it is answered
     if (stopDaemonOnClose && ProcessUtils::isDaemonRunning()) {
-        stopDaemon();
+        event->ignore();
+        hide();
+        DaemonIPC::sendQuitCommand(this, [](bool) {
+            QApplication::quit();
+        });
+        return;
     }
     
-    // Clean up PID file
-    QString guiPidFile = Config::instance().getGuiPidFilePath();
-    QFile::remove(guiPidFile);
-    
     event->accept();
 }
 
@@ -7,10 +7,13 @@
 #include <QDateTimeEdit>
 #include <QTimer>
 #include <QImage>
+#include <QJsonObject>
 
 namespace DiscordDrawRPC {
 
 class CropWidget;
+class DaemonStatusClient;
+class DaemonLauncher;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -41,8 +44,8 @@ private:
     void initUi();
     void initTrayIcon();
     void launchTrayProcess();
-    void storeGuiPid();
     void loadCurrentState();
+    void applyCurrentState(const QJsonObject& stateData);
     void updatePreview();
     QImage pixmapToImage(const QPixmap& pixmap);
     bool saveToCache(const QString& url, const QVector<qreal>& cropRectRatio);
@@ -76,7 +79,9 @@ private:
     QLabel* m_statusLabel;
     QLabel* m_daemonStatusLabel;
     
-    QTimer* m_daemonCheckTimer;
+    DaemonStatusClient* m_statusClient;
+    // Set while a daemon started from here isn't ready yet
+    DaemonLauncher* m_launcher;
     
     // Data
     QImage m_screenshot;
@@ -74,11 +74,11 @@ SettingsDialog::SettingsDialog(QWidget* parent)
 
 void SettingsDialog::loadCurrentSettings() {
     Config& config = Config::instance();
-    m_discordIdInput->setText(config.getValue("discord_client_id"));
-    m_imgurIdInput->setText(config.getValue("imgur_client_id"));
-    m_enableTrayCheckbox->setChecked(config.getConfig().value("enable_tray_icon").toBool());
-    m_stopDaemonOnCloseCheckbox->setChecked(config.getConfig().value("stop_daemon_on_close").toBool());
-    m_autoStartPresenceCheckbox->setChecked(config.getConfig().value("auto_start_presence").toBool());
+    m_discordIdInput->setText(config.discordClientId());
+    m_imgurIdInput->setText(config.imgurClientId());
+    m_enableTrayCheckbox->setChecked(config.enableTrayIcon());
+    m_stopDaemonOnCloseCheckbox->setChecked(config.stopDaemonOnClose());
+    m_autoStartPresenceCheckbox->setChecked(config.autoStartPresence());
 }
 
 QJsonObject SettingsDialog::getSettings() const {
@@ -11,8 +11,9 @@ int main(int argc, char *argv[]) {
     app.setWindowIcon(QIcon(":/icons/icon.png"));
     app.setStyle("Fusion");  // Modern look
     
-    // Check if another instance is already running
-    if (DiscordDrawRPC::ProcessUtils::isGuiRunning()) {
+    // Holding the PID file's lock is what marks this instance as running
+    QString pidFile = DiscordDrawRPC::Config::instance().getGuiPidFilePath();
+    if (!DiscordDrawRPC::ProcessUtils::lockPidFile(pidFile, QCoreApplication::applicationPid())) {
         QMessageBox::warning(
             nullptr,
             "Already Running",
@@ -27,6 +28,7 @@ int main(int argc, char *argv[]) {
     if (!config.load()) {
         qWarning() << "Failed to load configuration, using defaults";
     }
+    config.watchForChanges();
     
     DiscordDrawRPC::MainWindow window;
     window.show();
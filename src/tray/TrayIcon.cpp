@@ -3,6 +3,9 @@
 #include "../common/Common.h"
 #include "../common/PlatformUtils.h"
 #include "../common/DaemonIPC.h"
+#include "../common/ProcessWatcher.h"
+#include "../common/DaemonStatusClient.h"
+#include "../common/DaemonLauncher.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -20,14 +23,16 @@ namespace DiscordDrawRPC {
 
 const QString DISCORD_BLUE = "#5865F2";
 
+// How long the daemon gets to exit after a quit request
+const int DAEMON_STOP_TIMEOUT_MS = 5000;
+
 TrayIcon::TrayIcon(QObject* parent)
     : QObject(parent)
     , m_trayIcon(nullptr)
     , m_menu(nullptr)
-    , m_statusTimer(nullptr)
+    , m_statusClient(nullptr)
+    , m_launcher(nullptr)
 {
-    storeTrayPid();
-    
     m_trayIcon = new QSystemTrayIcon(this);
     
     setupIcon();
@@ -36,25 +41,14 @@ TrayIcon::TrayIcon(QObject* parent)
     connect(m_trayIcon, &QSystemTrayIcon::activated, 
             this, &TrayIcon::onTrayActivated);
     
-    // Timer to update tooltip
-    m_statusTimer = new QTimer(this);
-    connect(m_statusTimer, &QTimer::timeout, this, &TrayIcon::updateTooltip);
-    m_statusTimer->start(5000);  // Update every 5 seconds
+    // The daemon pushes its status changes
+    m_statusClient = new DaemonStatusClient(this);
+    connect(m_statusClient, &DaemonStatusClient::statusChanged, this, &TrayIcon::updateTooltip);
     updateTooltip();
 }
 
 TrayIcon::~TrayIcon() {
-    if (m_statusTimer) {
-        m_statusTimer->stop();
-    }
-    
-    QString trayPidFile = Config::instance().getTrayPidFilePath();
-    QFile::remove(trayPidFile);
-}
-
-void TrayIcon::storeTrayPid() {
-    QString pidFile = Config::instance().getTrayPidFilePath();
-    ProcessUtils::writePidFile(pidFile, QCoreApplication::applicationPid());
+    ProcessUtils::unlockPidFile(Config::instance().getTrayPidFilePath());
 }
 
 void TrayIcon::setupIcon() {
@@ -160,7 +154,7 @@ void TrayIcon::showWindow() {
 }
 
 void TrayIcon::startDaemon() {
-    if (ProcessUtils::isDaemonRunning()) {
+    if (m_launcher || ProcessUtils::isDaemonRunning()) {
         return;
     }
 
@@ -170,23 +164,32 @@ void TrayIcon::startDaemon() {
 
     QString daemonPath = getExecutablePath(ExecutableType::Daemon);
     
-    QProcess* process = new QProcess(this);
-    
-#ifdef _WIN32
-    process->setCreateProcessArgumentsModifier([](QProcess::CreateProcessArguments* args) {
-        args->flags |= CREATE_NO_WINDOW;
-    });
-#endif
-    
-    if (process->startDetached(daemonPath)) {
+    // Only reported as started once the daemon says it is ready
+    m_launcher = new DaemonLauncher(this);
+    connect(m_launcher, &DaemonLauncher::ready, this, [this]() {
+        m_launcher->deleteLater();
+        m_launcher = nullptr;
         m_trayIcon->showMessage(
             "Presence Started",
             "Discord RPC presence has been started.",
             QSystemTrayIcon::Information,
             2000
         );
-        updateTooltip();
-    } else {
+    });
+    connect(m_launcher, &DaemonLauncher::failed, this, [this](const QString& reason) {
+        m_launcher->deleteLater();
+        m_launcher = nullptr;
+        m_trayIcon->showMessage(
+            "Error",
+            QString("Failed to start presence: %1").arg(reason),
+            QSystemTrayIcon::Critical,
+            3000
+        );
+    });
+    
+    if (!m_launcher->start(daemonPath)) {
+        delete m_launcher;
+        m_launcher = nullptr;
         m_trayIcon->showMessage(
             "Error",
             "Failed to start presence",
@@ -201,58 +204,68 @@ void TrayIcon::stopDaemon() {
         return;
     }
     
-    if (DaemonIPC::sendQuitCommand()) {
+    qint64 pid = ProcessUtils::readPidFile(Config::instance().getDaemonPidFilePath());
+    DaemonIPC::sendQuitCommand(this, [this, pid](bool ok) {
+        if (!ok) {
+            return;
+        }
+        
         m_trayIcon->showMessage(
             "Presence Stopped",
             "Discord RPC presence has been stopped.",
             QSystemTrayIcon::Information,
             2000
         );
-        updateTooltip();
-    }
+        
+        // Refresh the tooltip once the daemon is actually gone
+        ProcessWatcher* watcher = new ProcessWatcher(pid, this);
+        watcher->setTimeout(DAEMON_STOP_TIMEOUT_MS);
+        connect(watcher, &ProcessWatcher::exited, this, [this, watcher]() {
+            watcher->deleteLater();
+            updateTooltip();
+        });
+        connect(watcher, &ProcessWatcher::timedOut, watcher, &QObject::deleteLater);
+    });
 }
 
 void TrayIcon::updateTooltip() {
     QString tooltip;
+    const DaemonStatusClient::Status& status = m_statusClient->status();
     
-    if (ProcessUtils::isDaemonRunning()) {
+    if (status.running && status.discordConnected) {
         tooltip = "Discord RPC - Presence Running ✅";
+    } else if (status.running) {
+        tooltip = "Discord RPC - Presence Waiting for Discord ⏳";
     } else {
         tooltip = "Discord RPC - Presence Stopped ⏸";
     }
     
     // Add current status if available
-    QJsonObject state = DaemonIPC::readCurrentState();
-    if (state.value("command").toString() == "update") {
-        QString details = state.value("details").toString();
-        if (!details.isEmpty()) {
-            tooltip += "\n" + details;
-        }
+    if (status.presenceActive && !status.details.isEmpty()) {
+        tooltip += "\n" + status.details;
     }
     
     m_trayIcon->setToolTip(tooltip);
 }
 
 void TrayIcon::exitApp() {
-    if (m_statusTimer) {
-        m_statusTimer->stop();
-    }
-    
     m_trayIcon->hide();
     
-    // Gracefully stop daemon if running
-    if (ProcessUtils::isDaemonRunning()) {
-        DaemonIPC::sendQuitCommand();
-    }
-    
     // Terminate GUI process if running
     if (ProcessUtils::isGuiRunning()) {
         ProcessUtils::terminateProcessFromPidFile(Config::instance().getGuiPidFilePath());
     }
     
-    // Clean up our PID file
-    QString trayPidFile = Config::instance().getTrayPidFilePath();
-    QFile::remove(trayPidFile);
+    // Release our PID file
+    ProcessUtils::unlockPidFile(Config::instance().getTrayPidFilePath());
+    
+    // Gracefully stop daemon if running, quitting once it has the request
+    if (ProcessUtils::isDaemonRunning()) {
+        DaemonIPC::sendQuitCommand(this, [](bool) {
+            QApplication::quit();
+        });
+        return;
+    }
     
     QApplication::quit();
 }
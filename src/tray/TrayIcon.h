@@ -3,10 +3,12 @@
 #include <QObject>
 #include <QSystemTrayIcon>
 #include <QMenu>
-#include <QTimer>
 
 namespace DiscordDrawRPC {
 
+class DaemonStatusClient;
+class DaemonLauncher;
+
 class TrayIcon : public QObject {
     Q_OBJECT
     
@@ -28,11 +30,12 @@ private slots:
 private:
     void setupIcon();
     void createMenu();
-    void storeTrayPid();
     
     QSystemTrayIcon* m_trayIcon;
     QMenu* m_menu;
-    QTimer* m_statusTimer;
+    DaemonStatusClient* m_statusClient;
+    // Set while a daemon started from here isn't ready yet
+    DaemonLauncher* m_launcher;
 };
 
 } // namespace DiscordDrawRPC
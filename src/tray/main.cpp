@@ -11,8 +11,9 @@ int main(int argc, char *argv[]) {
     app.setWindowIcon(QIcon(":/icons/icon.png"));
     app.setQuitOnLastWindowClosed(false);  // Keep running when window closes
     
-    // Check if another instance is already running
-    if (DiscordDrawRPC::ProcessUtils::isTrayRunning()) {
+    // Holding the PID file's lock is what marks this instance as running
+    QString pidFile = DiscordDrawRPC::Config::instance().getTrayPidFilePath();
+    if (!DiscordDrawRPC::ProcessUtils::lockPidFile(pidFile, QCoreApplication::applicationPid())) {
         QMessageBox::warning(
             nullptr,
             "Already Running",
@@ -0,0 +1,77 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+static std::atomic<quint64> allocations(0);
+
+#if defined(__GLIBC__)
+
+// glibc's own allocator under its internal names, so the definitions
+// below can replace the public ones for every library in the process
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+    // Growing in place still counts, the caller asked for more memory
+    if (size != 0) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = __libc_memalign(alignment, size);
+    if (!pointer) {
+        return ENOMEM;
+    }
+    *result = pointer;
+    return 0;
+}
+}
+
+#endif
+
+namespace DiscordDrawRPC {
+
+namespace AllocationCounter {
+
+bool isSupported() {
+#if defined(__GLIBC__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+quint64 count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace AllocationCounter
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QtGlobal>
+
+namespace DiscordDrawRPC {
+
+/**
+ * Heap allocation count of the whole process, for benchmarks that check a
+ * path allocates nothing. Linking AllocationCounter.cpp into an executable
+ * interposes malloc and its siblings, which covers operator new and Qt's
+ * containers alike. Only glibc provides the entry points the interposed
+ * functions forward to; elsewhere nothing is counted.
+ */
+namespace AllocationCounter {
+
+bool isSupported();
+
+// Allocations made by any thread since the process started
+quint64 count();
+
+} // namespace AllocationCounter
+
+} // namespace DiscordDrawRPC
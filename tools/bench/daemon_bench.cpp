@@ -0,0 +1,484 @@
+// Throughput and latency benchmark for the Discord RPC path, run against
+// MockDiscordServer instead of a real Discord client.
+//
+//   rpc     DiscordRPC alone: SET_ACTIVITY round trips with a bounded window
+//   daemon  The daemon process: startup time and resident memory, update
+//           requests over the control socket, then how long it takes for
+//           the last one to reach "Discord"
+//   busy    DiscordRPC round trips while the main thread keeps stalling,
+//           with the RPC on the main thread and then on an I/O thread
+//
+// The daemon still looks for Discord in /run/user/<uid> and /tmp, close
+// any real Discord client before running the daemon scenario.
+
+#include "MockDiscordServer.h"
+#include "common/Config.h"
+#include "common/DaemonIPC.h"
+#include "daemon/DiscordRPC.h"
+#include "daemon/LatencyHistogram.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <cstdio>
+#include <functional>
+
+using namespace DiscordDrawRPC;
+
+// Run the event loop until done() holds or the timeout expires
+static bool waitUntil(const std::function<bool()>& done, int timeoutMs) {
+    QTimer deadline;
+    deadline.setSingleShot(true);
+    deadline.start(timeoutMs);
+    
+    while (!done() && deadline.isActive()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return done();
+}
+
+static QJsonObject benchPresence(int index) {
+    QJsonObject presence;
+    presence["details"] = QString("Drawing #%1").arg(index);
+    presence["state"] = "daemon-bench";
+    return presence;
+}
+
+// Resident set of a process in KiB and the Qt libraries it has mapped,
+// read from /proc; -1 where that isn't available
+static qint64 residentKib(qint64 pid, QStringList& qtLibraries) {
+    QFile maps(QString("/proc/%1/maps").arg(pid));
+    if (maps.open(QIODevice::ReadOnly)) {
+        for (const QByteArray& line : maps.readAll().split('\n')) {
+            int start = line.indexOf("libQt6");
+            if (start < 0) {
+                continue;
+            }
+            QString library = QString::fromLatin1(line.mid(start + 6)).section('.', 0, 0);
+            if (!qtLibraries.contains(library)) {
+                qtLibraries.append(library);
+            }
+        }
+    }
+    
+    QFile status(QString("/proc/%1/status").arg(pid));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return -1;
+}
+
+static void printHistogram(const char* name, const LatencyHistogram& histogram) {
+    std::printf("  %-18s p50 %8.3f ms   p95 %8.3f ms   p99 %8.3f ms   max %8.3f ms\n", name,
+                histogram.percentile(50) / 1000.0, histogram.percentile(95) / 1000.0,
+                histogram.percentile(99) / 1000.0, histogram.max() / 1000.0);
+}
+
+static bool runRpcBenchmark(const QString& runtimeDir, int count, int window,
+                            const MockDiscordServer::Faults& faults, QJsonObject& results) {
+    MockDiscordServer server;
+    server.setFaults(faults);
+    if (!server.listen(runtimeDir + "/discord-ipc-0")) {
+        return false;
+    }
+    
+    DiscordRPC rpc("daemon-bench", server.endpoint());
+    rpc.connect();
+    if (!waitUntil([&]() { return rpc.isConnected(); }, 5000)) {
+        std::fprintf(stderr, "DiscordRPC did not connect to the mock server\n");
+        return false;
+    }
+    
+    LatencyHistogram roundTrips;
+    int sent = 0;
+    int completed = 0;
+    
+    auto sendNext = [&]() {
+        QByteArray activity = QJsonDocument(benchPresence(sent)).toJson(QJsonDocument::Compact);
+        if (rpc.updatePresence(activity) != 0) {
+            sent++;
+        }
+    };
+    
+    QObject::connect(&rpc, &DiscordRPC::commandCompleted, [&](const QString&, qint64 latencyMicros) {
+        roundTrips.record(latencyMicros);
+        completed++;
+        if (sent < count) {
+            sendNext();
+        }
+    });
+    
+    QElapsedTimer timer;
+    timer.start();
+    while (sent < qMin(window, count)) {
+        int before = sent;
+        sendNext();
+        if (sent == before) {
+            break;
+        }
+    }
+    
+    // Malformed responses never complete, so don't wait for those forever
+    waitUntil([&]() { return completed >= count || !rpc.isConnected(); }, 60000);
+    double seconds = timer.nsecsElapsed() / 1e9;
+    
+    std::printf("rpc: %d commands, window %d, %d completed in %.3f s (%.0f cmd/s)\n",
+                sent, window, completed, seconds, completed / seconds);
+    printHistogram("round trip", roundTrips);
+    
+    results["sent"] = sent;
+    results["completed"] = completed;
+    results["seconds"] = seconds;
+    results["commands_per_second"] = completed / seconds;
+    results["round_trip"] = roundTrips.toJson();
+    
+    rpc.disconnect();
+    return completed == count;
+}
+
+static bool runDaemonBenchmark(const QString& daemonPath, const QString& runtimeDir, int count, int window,
+                               const MockDiscordServer::Faults& faults, QJsonObject& results) {
+    MockDiscordServer server;
+    server.setFaults(faults);
+    if (!server.listen(runtimeDir + "/discord-ipc-0")) {
+        return false;
+    }
+    
+    bool handshake = false;
+    QObject::connect(&server, &MockDiscordServer::handshakeReceived, [&]() { handshake = true; });
+    
+    QProcess daemon;
+    daemon.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    QElapsedTimer startup;
+    startup.start();
+    daemon.start(daemonPath, QStringList());
+    if (!daemon.waitForStarted(5000)) {
+        std::fprintf(stderr, "Failed to start %s: %s\n", qPrintable(daemonPath), qPrintable(daemon.errorString()));
+        return false;
+    }
+    
+    if (!waitUntil([&]() { return handshake; }, 10000)) {
+        std::fprintf(stderr, "The daemon never connected to the mock server\n");
+        daemon.kill();
+        return false;
+    }
+    qint64 handshakeMs = startup.elapsed();
+    
+    QStringList qtLibraries;
+    qint64 rssKib = residentKib(daemon.processId(), qtLibraries);
+    
+    // The control socket comes up right after the Discord sessions
+    QLocalSocket control;
+    waitUntil([&]() {
+        if (control.state() == QLocalSocket::UnconnectedState) {
+            control.connectToServer(Config::instance().getControlSocketPath());
+        }
+        return control.state() == QLocalSocket::ConnectedState;
+    }, 5000);
+    if (control.state() != QLocalSocket::ConnectedState) {
+        std::fprintf(stderr, "Could not reach the daemon control socket\n");
+        daemon.kill();
+        return false;
+    }
+    
+    LatencyHistogram acks;
+    QHash<int, QElapsedTimer> inFlight;
+    QByteArray buffer;
+    QJsonObject stats;
+    int nextId = 1;
+    int acked = 0;
+    
+    auto sendRequest = [&](const QString& op, const QJsonObject& payload) {
+        QJsonObject request = payload;
+        request["id"] = nextId;
+        request["op"] = op;
+        inFlight[nextId].start();
+        nextId++;
+        control.write(DaemonProtocol::encode(request));
+    };
+    auto sendUpdate = [&](int index) {
+        QJsonObject state = benchPresence(index);
+        QJsonObject payload;
+        payload["state"] = state;
+        sendRequest("update", payload);
+    };
+    
+    QObject::connect(&control, &QLocalSocket::readyRead, [&]() {
+        buffer.append(control.readAll());
+        
+        QJsonObject message;
+        while (DaemonProtocol::decode(buffer, message) == DaemonProtocol::DecodeResult::Message) {
+            int id = message.value("id").toInt();
+            if (!inFlight.contains(id)) {
+                continue;
+            }
+            
+            qint64 latencyMicros = inFlight.take(id).nsecsElapsed() / 1000;
+            if (message.contains("stats")) {
+                stats = message.value("stats").toObject();
+                continue;
+            }
+            
+            acks.record(latencyMicros);
+            
+            acked++;
+            if (nextId <= count) {
+                sendUpdate(nextId);
+            }
+        }
+    });
+    
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < qMin(window, count); ++i) {
+        sendUpdate(nextId);
+    }
+    
+    waitUntil([&]() { return acked >= count || daemon.state() != QProcess::Running; }, 120000);
+    double seconds = timer.nsecsElapsed() / 1e9;
+    
+    // The rate limiter holds back all but the newest update, see how long
+    // it takes for that one to reach Discord
+    QByteArray expected = QJsonDocument(benchPresence(count)).toJson(QJsonDocument::Compact);
+    QElapsedTimer converge;
+    converge.start();
+    bool converged = waitUntil([&]() { return server.lastActivity() == expected; }, 30000);
+    qint64 convergeMs = converge.elapsed();
+    
+    sendRequest("stats", QJsonObject());
+    waitUntil([&]() { return !stats.isEmpty(); }, 2000);
+    
+    sendRequest("quit", QJsonObject());
+    if (!daemon.waitForFinished(5000)) {
+        daemon.kill();
+        daemon.waitForFinished(1000);
+    }
+    
+    std::printf("daemon: started and connected in %lld ms\n", static_cast<long long>(handshakeMs));
+    if (rssKib >= 0) {
+        std::printf("  %lld KiB resident once connected, Qt libraries: %s\n",
+                    static_cast<long long>(rssKib), qPrintable(qtLibraries.join(", ")));
+    }
+    std::printf("daemon: %d updates, window %d, %d acknowledged in %.3f s (%.0f req/s)\n",
+                count, window, acked, seconds, acked / seconds);
+    printHistogram("acknowledgement", acks);
+    std::printf("  %llu SET_ACTIVITY reached Discord, %lld coalesced, %lld suppressed\n",
+                static_cast<unsigned long long>(server.commandCount()),
+                stats.value("coalesced_updates").toVariant().toLongLong(),
+                stats.value("suppressed_updates").toVariant().toLongLong());
+    if (converged) {
+        std::printf("  last update shown %lld ms after its acknowledgement\n", static_cast<long long>(convergeMs));
+    } else {
+        std::printf("  last update never reached Discord\n");
+    }
+    
+    results["handshake_ms"] = handshakeMs;
+    results["rss_kib"] = rssKib;
+    results["qt_libraries"] = QJsonArray::fromStringList(qtLibraries);
+    results["acknowledged"] = acked;
+    results["seconds"] = seconds;
+    results["requests_per_second"] = acked / seconds;
+    results["acknowledgement"] = acks.toJson();
+    results["commands_sent"] = static_cast<qint64>(server.commandCount());
+    results["converged"] = converged;
+    results["converge_ms"] = convergeMs;
+    results["daemon_stats"] = stats;
+    
+    return acked == count && converged;
+}
+
+// One pass of the busy scenario; the round trip is measured by DiscordRPC
+// from writing a command to handling Discord's answer, so it grows with
+// whatever keeps the RPC's thread from reading the socket
+static bool runBusyPass(const QString& endpoint, bool ioThread, int count, int window, int stallMs,
+                        LatencyHistogram& roundTrips) {
+    QThread thread;
+    DiscordRPC* rpc = new DiscordRPC("daemon-bench", endpoint);
+    if (ioThread) {
+        thread.start();
+        rpc->moveToThread(&thread);
+    }
+    
+    QMetaObject::invokeMethod(rpc, &DiscordRPC::connect);
+    bool connected = waitUntil([&]() { return rpc->isConnected(); }, 5000);
+    
+    // Keep the main thread busy half of the time, like a stalled event loop
+    QTimer stall;
+    QObject::connect(&stall, &QTimer::timeout, [stallMs]() {
+        QElapsedTimer busy;
+        busy.start();
+        while (busy.elapsed() < stallMs) {
+        }
+    });
+    
+    // Delivered on this thread whichever thread the RPC runs on
+    QObject receiver;
+    int sent = 0;
+    int completed = 0;
+    auto sendNext = [&]() {
+        QByteArray activity = QJsonDocument(benchPresence(sent)).toJson(QJsonDocument::Compact);
+        if (rpc->postPresence(activity) != 0) {
+            sent++;
+        }
+    };
+    QObject::connect(rpc, &DiscordRPC::commandCompleted, &receiver, [&](const QString&, qint64 latencyMicros) {
+        roundTrips.record(latencyMicros);
+        completed++;
+        if (sent < count) {
+            sendNext();
+        }
+    });
+    
+    if (connected) {
+        stall.start(stallMs * 2);
+        while (sent < qMin(window, count)) {
+            sendNext();
+        }
+        waitUntil([&]() { return completed >= count || !rpc->isConnected(); }, 120000);
+        stall.stop();
+    } else {
+        std::fprintf(stderr, "DiscordRPC did not connect to the mock server\n");
+    }
+    
+    if (ioThread) {
+        QMetaObject::invokeMethod(rpc, [rpc]() { delete rpc; }, Qt::BlockingQueuedConnection);
+        thread.quit();
+        thread.wait();
+    } else {
+        delete rpc;
+    }
+    return connected && completed == count;
+}
+
+static bool runBusyBenchmark(const QString& runtimeDir, int count, int window, int stallMs, QJsonObject& results) {
+    // The mock answers from its own thread, stalls here must not delay it
+    QThread mockThread;
+    mockThread.start();
+    MockDiscordServer* server = new MockDiscordServer;
+    server->moveToThread(&mockThread);
+    
+    QString endpoint = runtimeDir + "/discord-ipc-0";
+    bool listening = false;
+    QMetaObject::invokeMethod(server, [&]() { listening = server->listen(endpoint); }, Qt::BlockingQueuedConnection);
+    
+    LatencyHistogram mainThread;
+    LatencyHistogram ioThread;
+    bool ok = listening
+        && runBusyPass(endpoint, false, count, window, stallMs, mainThread)
+        && runBusyPass(endpoint, true, count, window, stallMs, ioThread);
+        
+    QMetaObject::invokeMethod(server, [server]() { delete server; }, Qt::BlockingQueuedConnection);
+    mockThread.quit();
+    mockThread.wait();
+    
+    std::printf("busy: %d commands, window %d, main thread stalled %d ms out of every %d ms\n",
+                count, window, stallMs, stallMs * 2);
+    printHistogram("rpc on main", mainThread);
+    printHistogram("rpc on I/O thread", ioThread);
+    
+    results["stall_ms"] = stallMs;
+    results["main_thread"] = mainThread.toJson();
+    results["io_thread"] = ioThread.toJson();
+    
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Discord RPC throughput/latency benchmark against a mock Discord client");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scenario", "rpc, daemon, busy or all (default).");
+    QCommandLineOption countOption("count", "Updates to send.", "count", "5000");
+    QCommandLineOption windowOption("window", "Requests in flight at once.", "count", "16");
+    QCommandLineOption latencyOption("latency", "Mock server response delay.", "ms", "0");
+    QCommandLineOption malformedOption("malformed-every", "Mock answers every Nth command with invalid JSON.", "count", "0");
+    QCommandLineOption stallOption("stall", "How long the busy scenario blocks the main thread at a time.", "ms", "5");
+    QCommandLineOption daemonOption("daemon", "Daemon executable for the daemon scenario.", "path",
+                                    QCoreApplication::applicationDirPath() + "/../discord-drawing-rpc-daemon");
+    QCommandLineOption outputOption("output", "Write the results as JSON to this file.", "file");
+    parser.addOption(countOption);
+    parser.addOption(windowOption);
+    parser.addOption(latencyOption);
+    parser.addOption(malformedOption);
+    parser.addOption(stallOption);
+    parser.addOption(daemonOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+    
+    QString scenario = parser.positionalArguments().value(0, "all");
+    int count = qMax(1, parser.value(countOption).toInt());
+    int window = qMax(1, parser.value(windowOption).toInt());
+    
+    MockDiscordServer::Faults faults;
+    faults.responseDelayMs = parser.value(latencyOption).toInt();
+    faults.malformedEvery = parser.value(malformedOption).toInt();
+    
+    // Keep config, state and sockets away from a real installation;
+    // the daemon inherits the same environment
+    QTemporaryDir root;
+    if (!root.isValid()) {
+        std::fprintf(stderr, "Failed to create a temporary directory\n");
+        return 1;
+    }
+    QString runtimeDir = root.path() + "/runtime";
+    QDir().mkpath(runtimeDir);
+    qputenv("XDG_RUNTIME_DIR", runtimeDir.toLocal8Bit());
+    qputenv("XDG_CONFIG_HOME", (root.path() + "/config").toLocal8Bit());
+    qputenv("XDG_DATA_HOME", (root.path() + "/data").toLocal8Bit());
+    qputenv("TMPDIR", runtimeDir.toLocal8Bit());
+    
+    Config& config = Config::instance();
+    config.load();
+    config.setValue("discord_client_id", "daemon-bench");
+    config.save();
+    
+    QJsonObject results;
+    results["count"] = count;
+    results["window"] = window;
+    results["latency_ms"] = faults.responseDelayMs;
+    bool ok = true;
+    
+    if (scenario == "rpc" || scenario == "all") {
+        QJsonObject rpcResults;
+        ok = runRpcBenchmark(runtimeDir, count, window, faults, rpcResults) && ok;
+        results["rpc"] = rpcResults;
+    }
+    if (scenario == "daemon" || scenario == "all") {
+        QJsonObject daemonResults;
+        ok = runDaemonBenchmark(parser.value(daemonOption), runtimeDir, count, window, faults, daemonResults) && ok;
+        results["daemon"] = daemonResults;
+    }
+    if (scenario == "busy" || scenario == "all") {
+        QJsonObject busyResults;
+        ok = runBusyBenchmark(runtimeDir, count, window, qMax(1, parser.value(stallOption).toInt()), busyResults) && ok;
+        results["busy"] = busyResults;
+    }
+    
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(QJsonDocument(results).toJson(QJsonDocument::Indented));
+        } else {
+            std::fprintf(stderr, "Failed to write %s\n", qPrintable(parser.value(outputOption)));
+        }
+    }
+    
+    return ok ? 0 : 1;
+}
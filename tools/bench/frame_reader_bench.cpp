@@ -0,0 +1,140 @@
+// Throughput benchmark for the Discord IPC frame decoder.
+// Compares FrameReader against the QDataStream/mid()/remove() loop it replaced.
+
+#include "daemon/FrameReader.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <cstdio>
+
+using namespace DiscordDrawRPC;
+
+static QByteArray buildStream(qsizetype totalBytes, int payloadSize) {
+    QByteArray payload(payloadSize, 'x');
+    qsizetype frameSize = FrameReader::HEADER_SIZE + payloadSize;
+    qsizetype count = qMax<qsizetype>(1, totalBytes / frameSize);
+    
+    QByteArray stream;
+    stream.reserve(count * frameSize);
+    
+    char header[FrameReader::HEADER_SIZE];
+    qToLittleEndian<qint32>(1, header);
+    qToLittleEndian<qint32>(payloadSize, header + 4);
+    
+    for (qsizetype i = 0; i < count; ++i) {
+        stream.append(header, FrameReader::HEADER_SIZE);
+        stream.append(payload);
+    }
+    
+    return stream;
+}
+
+// The decoding loop DiscordRPC::processFrames used before FrameReader
+static qint64 legacyDecode(const QByteArray& stream, int chunkSize) {
+    QByteArray buffer;
+    qint64 frames = 0;
+    
+    for (qsizetype pos = 0; pos < stream.size(); pos += chunkSize) {
+        buffer.append(stream.constData() + pos, qMin<qsizetype>(chunkSize, stream.size() - pos));
+        
+        while (buffer.size() >= 8) {
+            QDataStream in(buffer);
+            in.setByteOrder(QDataStream::LittleEndian);
+            
+            qint32 opcode, length;
+            in >> opcode >> length;
+            
+            if (buffer.size() < 8 + length) {
+                break;
+            }
+            
+            QByteArray payload = buffer.mid(8, length);
+            buffer.remove(0, 8 + length);
+            frames += opcode + (payload.size() == length ? 0 : 1);
+        }
+    }
+    
+    return frames;
+}
+
+static qint64 readerDecode(const QByteArray& stream, int chunkSize) {
+    FrameReader reader;
+    FrameReader::Frame frame;
+    qint64 frames = 0;
+    
+    for (qsizetype pos = 0; pos < stream.size(); pos += chunkSize) {
+        reader.append(stream.constData() + pos, qMin<qsizetype>(chunkSize, stream.size() - pos));
+        
+        while (reader.next(frame) == FrameReader::Result::Frame) {
+            frames += frame.opcode;
+        }
+    }
+    
+    return frames;
+}
+
+template <typename Decoder>
+static double bestSeconds(Decoder decode, const QByteArray& stream, int chunkSize, int runs, qint64& frames) {
+    double best = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        frames = decode(stream, chunkSize);
+        double seconds = timer.nsecsElapsed() / 1e9;
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Discord IPC frame decoder throughput benchmark");
+    parser.addHelpOption();
+    QCommandLineOption bytesOption("bytes", "Stream size per scenario in bytes.", "bytes", "4194304");
+    QCommandLineOption runsOption("runs", "Runs per scenario, the best one is reported.", "runs", "3");
+    parser.addOption(bytesOption);
+    parser.addOption(runsOption);
+    parser.process(app);
+    
+    qsizetype totalBytes = parser.value(bytesOption).toLongLong();
+    int runs = qMax(1, parser.value(runsOption).toInt());
+    
+    const int payloadSizes[] = { 32, 512, 8192 };
+    const int chunkSizes[] = { 4096, 65536 };
+    
+    std::printf("%8s %8s %10s | %14s %10s | %14s %10s | %8s\n",
+                "payload", "chunk", "frames",
+                "legacy fr/s", "MB/s", "reader fr/s", "MB/s", "speedup");
+                
+    for (int payloadSize : payloadSizes) {
+        QByteArray stream = buildStream(totalBytes, payloadSize);
+        double megabytes = stream.size() / (1024.0 * 1024.0);
+        
+        for (int chunkSize : chunkSizes) {
+            qint64 legacyFrames = 0;
+            qint64 readerFrames = 0;
+            double legacy = bestSeconds(legacyDecode, stream, chunkSize, runs, legacyFrames);
+            double reader = bestSeconds(readerDecode, stream, chunkSize, runs, readerFrames);
+            
+            if (legacyFrames != readerFrames) {
+                std::fprintf(stderr, "Frame count mismatch: legacy %lld, reader %lld\n",
+                             static_cast<long long>(legacyFrames), static_cast<long long>(readerFrames));
+                return 1;
+            }
+            
+            std::printf("%8d %8d %10lld | %14.0f %10.1f | %14.0f %10.1f | %7.1fx\n",
+                        payloadSize, chunkSize, static_cast<long long>(readerFrames),
+                        readerFrames / legacy, megabytes / legacy,
+                        readerFrames / reader, megabytes / reader,
+                        legacy / reader);
+        }
+    }
+    
+    return 0;
+}
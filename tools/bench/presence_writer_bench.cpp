@@ -0,0 +1,232 @@
+// Presence serialization benchmark and allocation check.
+// Compares PresenceWriter against the QJsonObject/QJsonDocument path it
+// replaced, from an "update" command to the SET_ACTIVITY frame, and checks
+// that both produce the same bytes. Exits with an error when the writer
+// allocates once warmed up, i.e. when serializing an already decoded
+// presence and framing it is not allocation free.
+
+#include "AllocationCounter.h"
+#include "daemon/PresenceWriter.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <cstdio>
+#include <functional>
+
+using namespace DiscordDrawRPC;
+
+static constexpr qint64 BENCH_PID = 4242;
+
+// "update" commands as the GUI sends them, then one that exercises escaping
+static QJsonObject benchState(int variant) {
+    QJsonObject state;
+    state["command"] = "update";
+    if (variant == 0) {
+        state["details"] = "Drawing: sketch.kra";
+        state["state"] = "Krita";
+        state["large_image"] = "https://i.imgur.com/abcdefg.png";
+        state["large_text"] = "sketch.kra (1920x1080)";
+        state["small_image"] = "krita";
+        state["start"] = 1700000000000LL;
+        return state;
+    }
+    
+    state["details"] = QString::fromUtf8("\"Quoted\" \\ tab\tnewline\n bell\x07 caf\xC3\xA9 \xE7\x94\xBB \xF0\x9F\x8E\xA8");
+    state["state"] = QString::fromUtf8("\xE3\x81\x8A\xE7\xB5\xB5\xE6\x8F\x8F\xE3\x81\x8D");
+    state["large_image"] = "https://i.imgur.com/abcdefg.png";
+    state["start"] = 1700000000000LL;
+    QJsonObject button;
+    button["label"] = "Gallery";
+    button["url"] = "https://example.com/gallery?a=1&b=2";
+    state["buttons"] = QJsonArray { button };
+    return state;
+}
+
+// DiscordRPCDaemon::handleCommand before PresenceWriter
+static QByteArray legacyActivity(const QJsonObject& stateData) {
+    QJsonObject presence;
+    
+    QString state = stateData.value("state").toString();
+    QString details = stateData.value("details").toString();
+    if (!state.isEmpty()) {
+        presence["state"] = state;
+    }
+    if (!details.isEmpty()) {
+        presence["details"] = details;
+    }
+    
+    QJsonObject timestamps;
+    qint64 startTime = stateData.value("start").toVariant().toLongLong();
+    if (startTime > 0) {
+        timestamps["start"] = startTime;
+    }
+    if (!timestamps.isEmpty()) {
+        presence["timestamps"] = timestamps;
+    }
+    
+    QJsonObject assets;
+    QString largeImage = stateData.value("large_image").toString();
+    QString largeText = stateData.value("large_text").toString();
+    QString smallImage = stateData.value("small_image").toString();
+    QString smallText = stateData.value("small_text").toString();
+    if (!largeImage.isEmpty()) {
+        assets["large_image"] = largeImage;
+        if (!largeText.isEmpty()) {
+            assets["large_text"] = largeText;
+        }
+    }
+    if (!smallImage.isEmpty()) {
+        assets["small_image"] = smallImage;
+        if (!smallText.isEmpty()) {
+            assets["small_text"] = smallText;
+        }
+    }
+    if (!assets.isEmpty()) {
+        presence["assets"] = assets;
+    }
+    
+    QJsonArray buttons = stateData.value("buttons").toArray();
+    if (!buttons.isEmpty()) {
+        presence["buttons"] = buttons;
+    }
+    
+    return QJsonDocument(presence).toJson(QJsonDocument::Compact);
+}
+
+// DiscordRPC's presence arguments, command envelope and frame before PresenceWriter
+static QByteArray legacyFrame(const QByteArray& activity, qint64 pid, quint64 counter) {
+    QByteArray args;
+    args.reserve(activity.size() + 40);
+    args.append("{\"activity\":").append(activity);
+    args.append(",\"pid\":").append(QByteArray::number(pid)).append('}');
+    
+    QString nonce = QString::number(counter);
+    QByteArray payload;
+    payload.reserve(args.size() + 64);
+    payload.append("{\"cmd\":\"").append("SET_ACTIVITY");
+    payload.append("\",\"args\":").append(args);
+    payload.append(",\"nonce\":\"").append(nonce.toLatin1()).append("\"}");
+    
+    QByteArray frame;
+    frame.reserve(8 + payload.size());
+    char header[8];
+    qToLittleEndian<qint32>(1, header);
+    qToLittleEndian<qint32>(static_cast<qint32>(payload.size()), header + 4);
+    frame.append(header, 8);
+    frame.append(payload);
+    return frame;
+}
+
+struct Measurement {
+    double nanosPerUpdate = 0.0;
+    double allocationsPerUpdate = 0.0;
+};
+
+// Best of several runs; allocations are counted over the first one
+static Measurement measure(const std::function<qsizetype(int)>& update, int updates, int runs) {
+    Measurement measurement;
+    for (int run = 0; run < runs; ++run) {
+        quint64 allocationsBefore = AllocationCounter::count();
+        QElapsedTimer timer;
+        timer.start();
+        
+        qsizetype bytes = 0;
+        for (int i = 0; i < updates; ++i) {
+            bytes += update(i);
+        }
+        
+        double nanos = double(timer.nsecsElapsed()) / updates;
+        if (run == 0) {
+            measurement.allocationsPerUpdate = double(AllocationCounter::count() - allocationsBefore) / updates;
+        }
+        if (run == 0 || nanos < measurement.nanosPerUpdate) {
+            measurement.nanosPerUpdate = nanos;
+        }
+        if (bytes == 0) {
+            std::fprintf(stderr, "Nothing was serialized\n");
+        }
+    }
+    return measurement;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Presence serialization benchmark and heap allocation check");
+    parser.addHelpOption();
+    QCommandLineOption updatesOption("updates", "Updates per run.", "count", "100000");
+    QCommandLineOption runsOption("runs", "Runs per path, the best one is reported.", "runs", "3");
+    parser.addOption(updatesOption);
+    parser.addOption(runsOption);
+    parser.process(app);
+    
+    int updates = qMax(1, parser.value(updatesOption).toInt());
+    int runs = qMax(1, parser.value(runsOption).toInt());
+    
+    if (!AllocationCounter::isSupported()) {
+        std::printf("Allocation counting needs glibc, only timings are meaningful\n");
+    }
+    
+    bool ok = true;
+    // Separate writers, as in the daemon and DiscordRPC: the frame is
+    // written while the activity is read from the other buffer
+    PresenceWriter writer;
+    PresenceWriter frameWriter;
+    
+    std::printf("%8s | %12s %12s | %12s %12s | %12s %12s\n", "variant",
+                "legacy ns", "allocs", "writer ns", "allocs", "warm ns", "allocs");
+    
+    for (int variant = 0; variant < 2; ++variant) {
+        QJsonObject stateData = benchState(variant);
+        Presence presence = Presence::fromState(stateData);
+        
+        // Same canonical activity and the same frame byte for byte
+        QByteArray expectedActivity = legacyActivity(stateData);
+        QByteArray activity = writer.writeActivity(presence);
+        QByteArray expectedFrame = legacyFrame(expectedActivity, BENCH_PID, 1);
+        QByteArray frame = frameWriter.writeSetActivityFrame(activity, BENCH_PID, 1);
+        if (activity != expectedActivity || frame != expectedFrame) {
+            std::fprintf(stderr, "Variant %d differs from the legacy serialization:\n  legacy %s\n  writer %s\n",
+                         variant, expectedFrame.constData() + 8, frame.constData() + 8);
+            ok = false;
+            continue;
+        }
+        
+        // The whole path, decoding the command included
+        Measurement legacy = measure([&](int i) {
+            return legacyFrame(legacyActivity(stateData), BENCH_PID, i + 1).size();
+        }, updates, runs);
+        Measurement full = measure([&](int i) {
+            const QByteArray& written = writer.writeActivity(Presence::fromState(stateData));
+            return frameWriter.writeSetActivityFrame(written, BENCH_PID, i + 1).size();
+        }, updates, runs);
+        
+        // What the daemon and DiscordRPC redo for every update once the
+        // command is decoded, after one update has sized both buffers and
+        // nothing else shares them
+        activity = QByteArray();
+        frame = QByteArray();
+        frameWriter.writeSetActivityFrame(writer.writeActivity(presence), BENCH_PID, 1);
+        Measurement warm = measure([&](int i) {
+            const QByteArray& written = writer.writeActivity(presence);
+            return frameWriter.writeSetActivityFrame(written, BENCH_PID, i + 1).size();
+        }, updates, runs);
+        
+        std::printf("%8d | %12.0f %12.2f | %12.0f %12.2f | %12.0f %12.2f\n", variant,
+                    legacy.nanosPerUpdate, legacy.allocationsPerUpdate,
+                    full.nanosPerUpdate, full.allocationsPerUpdate,
+                    warm.nanosPerUpdate, warm.allocationsPerUpdate);
+        
+        if (AllocationCounter::isSupported() && warm.allocationsPerUpdate > 0.0) {
+            std::fprintf(stderr, "Variant %d: the warmed up writer allocated %.2f times per update\n",
+                         variant, warm.allocationsPerUpdate);
+            ok = false;
+        }
+    }
+    
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// Startup benchmark: how long after launching the daemon its first
+// SET_ACTIVITY reaches a mock Discord client, broken down by the startup
+// markers the daemon writes to stderr (see daemon/StartupMarkers.h).
+//
+//   cold  Every run gets a fresh profile holding only the config and the
+//         presence to show: no log, PID file or remembered Discord socket
+//   warm  Runs share one profile, used once by a run that isn't counted
+//
+// Neither empties the OS page cache, so a cold run is the first start on a
+// new profile rather than the first start after boot.
+//
+// The daemon still looks for Discord in /run/user/<uid> and /tmp, close
+// any real Discord client before running this.
+
+#include "MockDiscordServer.h"
+#include "common/Config.h"
+#include "common/DaemonIPC.h"
+#include "daemon/LatencyHistogram.h"
+#include "daemon/StartupMarkers.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+using namespace DiscordDrawRPC;
+
+// Daemon markers in the order they are reached, then the mock's first SET_ACTIVITY
+static const char* const PHASES[] = {
+    "main",
+    "pid_locked",
+    "config_loaded",
+    "logger_started",
+    "sessions_started",
+    "control_listening",
+    "initial_state_applied",
+    "discord_ready",
+    "presence_sent",
+    "first_set_activity",
+};
+static constexpr int PHASE_COUNT = sizeof(PHASES) / sizeof(PHASES[0]);
+
+using PhaseTimes = std::array<qint64, PHASE_COUNT>;
+
+struct Series {
+    std::array<LatencyHistogram, PHASE_COUNT> phases;
+    int failures = 0;
+};
+
+// Same clock as the daemon's markers
+static qint64 nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Run the event loop until done() holds or the timeout expires
+static bool waitUntil(const std::function<bool()>& done, int timeoutMs) {
+    QTimer deadline;
+    deadline.setSingleShot(true);
+    deadline.start(timeoutMs);
+    
+    while (!done() && deadline.isActive()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return done();
+}
+
+// Point config and data at a profile directory, the daemon inherits it
+static void useProfile(const QString& path) {
+    qputenv("XDG_CONFIG_HOME", (path + "/config").toLocal8Bit());
+    qputenv("XDG_DATA_HOME", (path + "/data").toLocal8Bit());
+    Config::instance().reloadPlatformDirs();
+}
+
+// The presence the daemon applies from the state file once connected;
+// rewritten before every run since a quit request persists "quit"
+static bool writeBenchState() {
+    QJsonObject state;
+    state["command"] = "update";
+    state["details"] = "startup-bench";
+    state["state"] = "Time to first presence";
+    return DaemonIPC::writeStateSnapshot(state);
+}
+
+static bool prepareProfile(const QString& path) {
+    useProfile(path);
+    
+    Config& config = Config::instance();
+    config.load();
+    config.setValue("discord_client_id", "startup-bench");
+    return config.save() && writeBenchState();
+}
+
+// Launch the daemon once and time every phase from the launch, -1 for
+// phases that were never reached
+static bool runOnce(const QString& daemonPath, MockDiscordServer& server, PhaseTimes& times) {
+    times.fill(-1);
+    if (!writeBenchState()) {
+        std::fprintf(stderr, "Failed to write the state file\n");
+        return false;
+    }
+    
+    qint64 setActivityAt = -1;
+    QMetaObject::Connection connection = QObject::connect(&server, &MockDiscordServer::commandReceived,
+                                                          [&](const QString& cmd, const QJsonObject&) {
+        if (cmd == "SET_ACTIVITY" && setActivityAt < 0) {
+            setActivityAt = nowMicros();
+        }
+    });
+    
+    QProcess daemon;
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(STARTUP_MARKERS_ENV, "1");
+    daemon.setProcessEnvironment(environment);
+    daemon.setStandardOutputFile(QProcess::nullDevice());
+    
+    qint64 launchedAt = nowMicros();
+    daemon.start(daemonPath, QStringList());
+    if (!daemon.waitForStarted(5000)) {
+        std::fprintf(stderr, "Failed to start %s: %s\n", qPrintable(daemonPath), qPrintable(daemon.errorString()));
+        QObject::disconnect(connection);
+        return false;
+    }
+    
+    waitUntil([&]() { return setActivityAt >= 0 || daemon.state() != QProcess::Running; }, 15000);
+    QObject::disconnect(connection);
+    
+    if (daemon.state() == QProcess::Running) {
+        DaemonIPC::sendQuitCommand();
+        if (!daemon.waitForFinished(5000)) {
+            daemon.kill();
+            daemon.waitForFinished(1000);
+        }
+    }
+    
+    // Log output shares stderr with the markers
+    for (const QByteArray& line : daemon.readAllStandardError().split('\n')) {
+        QList<QByteArray> fields = line.trimmed().split(' ');
+        if (fields.size() != 3 || fields[0] != "startup-marker") {
+            continue;
+        }
+        for (int i = 0; i < PHASE_COUNT; ++i) {
+            if (fields[1] == PHASES[i]) {
+                times[i] = fields[2].toLongLong() - launchedAt;
+            }
+        }
+    }
+    
+    if (setActivityAt < 0) {
+        std::fprintf(stderr, "The daemon never set an activity\n");
+        return false;
+    }
+    times[PHASE_COUNT - 1] = setActivityAt - launchedAt;
+    return true;
+}
+
+static void record(Series& series, bool ok, const PhaseTimes& times) {
+    if (!ok) {
+        series.failures++;
+        return;
+    }
+    
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        if (times[i] >= 0) {
+            series.phases[i].record(times[i]);
+        }
+    }
+}
+
+static void printSeries(const char* name, const Series& series, int runs) {
+    std::printf("%s: %d runs, %d failed, time since launch\n", name, runs, series.failures);
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        const LatencyHistogram& histogram = series.phases[i];
+        if (histogram.count() == 0) {
+            continue;
+        }
+        std::printf("  %-22s mean %8.3f ms   p50 %8.3f ms   p95 %8.3f ms   max %8.3f ms\n", PHASES[i],
+                    histogram.mean() / 1000.0, histogram.percentile(50) / 1000.0,
+                    histogram.percentile(95) / 1000.0, histogram.max() / 1000.0);
+    }
+}
+
+static QJsonObject seriesJson(const Series& series) {
+    QJsonObject phases;
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        if (series.phases[i].count() > 0) {
+            phases[PHASES[i]] = series.phases[i].toJson();
+        }
+    }
+    
+    QJsonObject json;
+    json["failures"] = series.failures;
+    json["phases"] = phases;
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Daemon startup and time-to-first-presence benchmark against a mock Discord client");
+    parser.addHelpOption();
+    QCommandLineOption runsOption("runs", "Cold and warm runs each.", "count", "10");
+    QCommandLineOption daemonOption("daemon", "Daemon executable.", "path",
+                                    QCoreApplication::applicationDirPath() + "/../discord-drawing-rpc-daemon");
+    QCommandLineOption outputOption("output", "Write the results as JSON to this file.", "file");
+    parser.addOption(runsOption);
+    parser.addOption(daemonOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+    
+    int runs = qMax(1, parser.value(runsOption).toInt());
+    QString daemonPath = parser.value(daemonOption);
+    
+    // Keep config, state and sockets away from a real installation;
+    // the daemon inherits the same environment
+    QTemporaryDir root;
+    if (!root.isValid()) {
+        std::fprintf(stderr, "Failed to create a temporary directory\n");
+        return 1;
+    }
+    QString runtimeDir = root.path() + "/runtime";
+    QDir().mkpath(runtimeDir);
+    qputenv("XDG_RUNTIME_DIR", runtimeDir.toLocal8Bit());
+    qputenv("TMPDIR", runtimeDir.toLocal8Bit());
+    
+    MockDiscordServer server;
+    if (!server.listen(runtimeDir + "/discord-ipc-0")) {
+        std::fprintf(stderr, "Failed to listen on %s\n", qPrintable(runtimeDir + "/discord-ipc-0"));
+        return 1;
+    }
+    
+    PhaseTimes times;
+    
+    Series cold;
+    for (int i = 0; i < runs; ++i) {
+        bool ok = prepareProfile(root.path() + QString("/cold-%1").arg(i)) && runOnce(daemonPath, server, times);
+        record(cold, ok, times);
+    }
+    
+    Series warm;
+    if (!prepareProfile(root.path() + "/warm") || !runOnce(daemonPath, server, times)) {
+        std::fprintf(stderr, "Warm-up run failed\n");
+    }
+    for (int i = 0; i < runs; ++i) {
+        record(warm, runOnce(daemonPath, server, times), times);
+    }
+    
+    printSeries("cold", cold, runs);
+    printSeries("warm", warm, runs);
+    
+    if (parser.isSet(outputOption)) {
+        QJsonObject results;
+        results["runs"] = runs;
+        results["cold"] = seriesJson(cold);
+        results["warm"] = seriesJson(warm);
+        
+        QFile file(parser.value(outputOption));
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(QJsonDocument(results).toJson(QJsonDocument::Indented));
+        } else {
+            std::fprintf(stderr, "Failed to write %s\n", qPrintable(parser.value(outputOption)));
+        }
+    }
+    
+    return cold.failures == 0 && warm.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#include "MockDiscordServer.h"
+#include <QJsonDocument>
+#include <QTimer>
+#include <QtEndian>
+#include <QDebug>
+
+namespace DiscordDrawRPC {
+
+// Discord IPC opcodes
+enum OpCode {
+    HANDSHAKE = 0,
+    FRAME = 1,
+    CLOSE = 2,
+    PING = 3,
+    PONG = 4
+};
+
+MockDiscordServer::MockDiscordServer(QObject* parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_commandCount(0)
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &MockDiscordServer::onNewConnection);
+}
+
+MockDiscordServer::~MockDiscordServer() {
+    close();
+}
+
+bool MockDiscordServer::listen(const QString& endpoint) {
+    // A previous run may have left its socket file behind
+    QLocalServer::removeServer(endpoint);
+    
+    if (!m_server->listen(endpoint)) {
+        qWarning() << "Failed to listen on" << endpoint << ":" << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+void MockDiscordServer::close() {
+    for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
+        it.key()->disconnect(this);
+        it.key()->abort();
+        it.key()->deleteLater();
+        delete it.value();
+    }
+    m_clients.clear();
+    m_server->close();
+}
+
+void MockDiscordServer::pingClients() {
+    for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        writeFrame(it.key(), OpCode::PING, "{}");
+    }
+}
+
+void MockDiscordServer::onNewConnection() {
+    while (QLocalSocket* socket = m_server->nextPendingConnection()) {
+        m_clients.insert(socket, new Client);
+        
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            onDisconnected(socket);
+        });
+    }
+}
+
+void MockDiscordServer::onDisconnected(QLocalSocket* socket) {
+    Client* client = m_clients.take(socket);
+    if (!client) {
+        return;
+    }
+    
+    delete client;
+    socket->deleteLater();
+    emit clientDisconnected();
+}
+
+void MockDiscordServer::onReadyRead(QLocalSocket* socket) {
+    Client* client = m_clients.value(socket);
+    if (!client) {
+        return;
+    }
+    
+    client->reader.readFrom(socket);
+    
+    FrameReader::Frame frame;
+    FrameReader::Result result;
+    while ((result = client->reader.next(frame)) == FrameReader::Result::Frame) {
+        handleFrame(socket, *client, frame);
+        
+        // Injected disconnects and CLOSE may have removed the client
+        if (!m_clients.contains(socket)) {
+            return;
+        }
+    }
+    
+    if (result == FrameReader::Result::Oversized) {
+        qWarning() << "Client sent an oversized frame, dropping it";
+        socket->abort();
+    }
+}
+
+void MockDiscordServer::handleFrame(QLocalSocket* socket, Client& client, const FrameReader::Frame& frame) {
+    QJsonObject message = QJsonDocument::fromJson(frame.payloadView()).object();
+    
+    switch (frame.opcode) {
+    case OpCode::HANDSHAKE: {
+        emit handshakeReceived(message.value("client_id").toString());
+        
+        if (m_faults.rejectHandshake) {
+            writeFrame(socket, OpCode::CLOSE, "{\"code\":4000,\"message\":\"Invalid Client ID\"}");
+            socket->disconnectFromServer();
+            return;
+        }
+        
+        client.ready = true;
+        reply(socket, OpCode::FRAME,
+              "{\"cmd\":\"DISPATCH\",\"data\":{\"v\":1,\"config\":{\"api_endpoint\":\"//discord.com/api\"},"
+              "\"user\":{\"id\":\"0\",\"username\":\"mock\"}},\"evt\":\"READY\",\"nonce\":null}");
+        break;
+    }
+    case OpCode::FRAME: {
+        if (!client.ready) {
+            socket->abort();
+            return;
+        }
+        
+        QString cmd = message.value("cmd").toString();
+        QJsonObject args = message.value("args").toObject();
+        client.commands++;
+        m_commandCount++;
+        
+        // Discord echoes the activity it applied
+        QJsonValue data = QJsonValue::Null;
+        if (cmd == "SET_ACTIVITY") {
+            QJsonValue activity = args.value("activity");
+            if (activity.isObject()) {
+                data = activity;
+                m_lastActivity = QJsonDocument(activity.toObject()).toJson(QJsonDocument::Compact);
+            } else {
+                m_lastActivity = "null";
+            }
+        }
+        emit commandReceived(cmd, args);
+        
+        if (m_faults.disconnectAfter > 0 && client.commands >= quint64(m_faults.disconnectAfter)) {
+            socket->abort();
+            return;
+        }
+        
+        if (m_faults.malformedEvery > 0 && client.commands % m_faults.malformedEvery == 0) {
+            reply(socket, OpCode::FRAME, "{\"cmd\":\"" + cmd.toLatin1() + "\",\"data\":");
+            break;
+        }
+        
+        QJsonObject response;
+        response["cmd"] = cmd;
+        response["data"] = data;
+        response["evt"] = QJsonValue::Null;
+        response["nonce"] = message.value("nonce");
+        reply(socket, OpCode::FRAME, QJsonDocument(response).toJson(QJsonDocument::Compact));
+        break;
+    }
+    case OpCode::PING:
+        writeFrame(socket, OpCode::PONG, frame.payloadView());
+        break;
+    case OpCode::CLOSE:
+        socket->disconnectFromServer();
+        break;
+    default:
+        break;
+    }
+}
+
+void MockDiscordServer::reply(QLocalSocket* socket, int opcode, const QByteArray& payload) {
+    if (m_faults.responseDelayMs <= 0) {
+        writeFrame(socket, opcode, payload);
+        return;
+    }
+    
+    // Dropped along with the socket if the client goes away first
+    QTimer::singleShot(m_faults.responseDelayMs, socket, [socket, opcode, payload]() {
+        writeFrame(socket, opcode, payload);
+    });
+}
+
+void MockDiscordServer::writeFrame(QLocalSocket* socket, int opcode, const QByteArray& payload) {
+    if (socket->state() != QLocalSocket::ConnectedState) {
+        return;
+    }
+    
+    char header[FrameReader::HEADER_SIZE];
+    qToLittleEndian<qint32>(opcode, header);
+    qToLittleEndian<qint32>(static_cast<qint32>(payload.size()), header + 4);
+    socket->write(header, FrameReader::HEADER_SIZE);
+    socket->write(payload);
+}
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include "daemon/FrameReader.h"
+
+namespace DiscordDrawRPC {
+
+/**
+ * Local stand-in for a Discord client's IPC endpoint.
+ * Listens on a discord-ipc-N socket and speaks enough of the protocol
+ * (HANDSHAKE/READY, FRAME commands, PING/PONG, CLOSE) to drive DiscordRPC
+ * and the daemon without Discord. Faults can be injected to exercise
+ * latency, dropped connections and corrupt frames.
+ */
+class MockDiscordServer : public QObject {
+    Q_OBJECT
+    
+public:
+    struct Faults {
+        int responseDelayMs = 0;        // Delay before answering a handshake or command
+        int disconnectAfter = 0;        // Drop the client after this many commands, 0 for never
+        int malformedEvery = 0;         // Answer every Nth command with invalid JSON, 0 for never
+        bool rejectHandshake = false;   // Answer the handshake with CLOSE
+    };
+    
+    explicit MockDiscordServer(QObject* parent = nullptr);
+    ~MockDiscordServer();
+    
+    // Full path of the socket (or pipe name) to listen on
+    bool listen(const QString& endpoint);
+    void close();
+    QString endpoint() const { return m_server->fullServerName(); }
+    
+    void setFaults(const Faults& faults) { m_faults = faults; }
+    
+    // Send a PING to every connected client
+    void pingClients();
+    
+    int clientCount() const { return m_clients.size(); }
+    quint64 commandCount() const { return m_commandCount; }
+    // Activity of the last SET_ACTIVITY in compact JSON, "null" once cleared
+    QByteArray lastActivity() const { return m_lastActivity; }
+    
+signals:
+    void handshakeReceived(const QString& clientId);
+    void commandReceived(const QString& cmd, const QJsonObject& args);
+    void clientDisconnected();
+    
+private slots:
+    void onNewConnection();
+    
+private:
+    struct Client {
+        FrameReader reader;
+        bool ready = false;
+        quint64 commands = 0;
+    };
+    
+    void onReadyRead(QLocalSocket* socket);
+    void onDisconnected(QLocalSocket* socket);
+    void handleFrame(QLocalSocket* socket, Client& client, const FrameReader::Frame& frame);
+    void reply(QLocalSocket* socket, int opcode, const QByteArray& payload);
+    static void writeFrame(QLocalSocket* socket, int opcode, const QByteArray& payload);
+    
+    QLocalServer* m_server;
+    QHash<QLocalSocket*, Client*> m_clients;
+    Faults m_faults;
+    quint64 m_commandCount;
+    QByteArray m_lastActivity;
+};
+
+} // namespace DiscordDrawRPC
@@ -0,0 +1,92 @@
+// Stand-alone mock Discord client for manual testing of the daemon.
+// Listens on a discord-ipc-N socket and logs every command it receives.
+
+#include "MockDiscordServer.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QTimer>
+#include <QDir>
+#include <cstdio>
+
+using namespace DiscordDrawRPC;
+
+static QString defaultEndpoint(int index) {
+#ifdef _WIN32
+    return QString("\\\\.\\pipe\\discord-ipc-%1").arg(index);
+#else
+    QString dir = qEnvironmentVariable("XDG_RUNTIME_DIR");
+    if (dir.isEmpty()) {
+        dir = QDir::tempPath();
+    }
+    return QString("%1/discord-ipc-%2").arg(dir).arg(index);
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mock Discord IPC server");
+    parser.addHelpOption();
+    QCommandLineOption socketOption("socket", "Socket path or pipe name to listen on.", "path");
+    QCommandLineOption indexOption("index", "Pipe number used when --socket is not given.", "n", "0");
+    QCommandLineOption latencyOption("latency", "Delay before every response.", "ms", "0");
+    QCommandLineOption disconnectOption("disconnect-after", "Drop a client after this many commands.", "count", "0");
+    QCommandLineOption malformedOption("malformed-every", "Answer every Nth command with invalid JSON.", "count", "0");
+    QCommandLineOption rejectOption("reject-handshake", "Close every connection during the handshake.");
+    QCommandLineOption pingOption("ping-interval", "Send PING to connected clients periodically.", "ms", "0");
+    QCommandLineOption quietOption("quiet", "Don't log received commands.");
+    parser.addOption(socketOption);
+    parser.addOption(indexOption);
+    parser.addOption(latencyOption);
+    parser.addOption(disconnectOption);
+    parser.addOption(malformedOption);
+    parser.addOption(rejectOption);
+    parser.addOption(pingOption);
+    parser.addOption(quietOption);
+    parser.process(app);
+    
+    MockDiscordServer::Faults faults;
+    faults.responseDelayMs = parser.value(latencyOption).toInt();
+    faults.disconnectAfter = parser.value(disconnectOption).toInt();
+    faults.malformedEvery = parser.value(malformedOption).toInt();
+    faults.rejectHandshake = parser.isSet(rejectOption);
+    
+    MockDiscordServer server;
+    server.setFaults(faults);
+    
+    QString endpoint = parser.isSet(socketOption)
+        ? parser.value(socketOption)
+        : defaultEndpoint(parser.value(indexOption).toInt());
+    if (!server.listen(endpoint)) {
+        return 1;
+    }
+    std::printf("Listening on %s\n", qPrintable(server.endpoint()));
+    std::fflush(stdout);
+    
+    bool quiet = parser.isSet(quietOption);
+    QObject::connect(&server, &MockDiscordServer::handshakeReceived, [](const QString& clientId) {
+        std::printf("HANDSHAKE client_id=%s\n", qPrintable(clientId));
+        std::fflush(stdout);
+    });
+    QObject::connect(&server, &MockDiscordServer::commandReceived, [quiet](const QString& cmd, const QJsonObject& args) {
+        if (!quiet) {
+            std::printf("%s %s\n", qPrintable(cmd), QJsonDocument(args).toJson(QJsonDocument::Compact).constData());
+            std::fflush(stdout);
+        }
+    });
+    QObject::connect(&server, &MockDiscordServer::clientDisconnected, []() {
+        std::printf("Client disconnected\n");
+        std::fflush(stdout);
+    });
+    
+    QTimer pingTimer;
+    int pingInterval = parser.value(pingOption).toInt();
+    if (pingInterval > 0) {
+        QObject::connect(&pingTimer, &QTimer::timeout, &server, &MockDiscordServer::pingClients);
+        pingTimer.start(pingInterval);
+    }
+    
+    return app.exec();
+}
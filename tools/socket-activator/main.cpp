@@ -0,0 +1,183 @@
+// Stand-in for systemd's socket activation, for trying the daemon's on-demand
+// start without a service manager. Listens on the control socket and starts
+// the given command once a client connects, handing the listening socket
+// over as fd 3 with LISTEN_FDS/LISTEN_PID set. The connection waits in the
+// socket's backlog until the daemon accepts it. When the daemon exits, on
+// its idle timeout or otherwise, the next connection starts it again.
+
+#include "common/Config.h"
+#include "daemon/SocketActivation.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QElapsedTimer>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace DiscordDrawRPC;
+
+// A command that exits sooner than this leaves the connection that started
+// it pending, wait before starting it again instead of spinning
+static constexpr qint64 MIN_RUN_MS = 1000;
+static constexpr unsigned RESTART_DELAY_S = 1;
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void onSignal(int) {
+    g_stop = 1;
+}
+
+static int listenOn(const QByteArray& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= static_cast<qsizetype>(sizeof(address.sun_path))) {
+        std::fprintf(stderr, "Socket path too long: %s\n", path.constData());
+        return -1;
+    }
+    std::memcpy(address.sun_path, path.constData(), path.size());
+    
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::fprintf(stderr, "Failed to create socket: %s\n", std::strerror(errno));
+        return -1;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    
+    // Same as the daemon: a stale socket goes, only the user may connect
+    ::unlink(path.constData());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::chmod(path.constData(), S_IRUSR | S_IWUSR) < 0
+        || ::listen(fd, SOMAXCONN) < 0) {
+        std::fprintf(stderr, "Failed to listen on %s: %s\n", path.constData(), std::strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static pid_t spawn(int fd, const std::vector<char*>& argv) {
+    pid_t pid = ::fork();
+    if (pid != 0) {
+        return pid;
+    }
+    
+    // Child: the socket becomes fd 3, dup2() leaves it open across exec
+    if (fd == LISTEN_FDS_START) {
+        ::fcntl(fd, F_SETFD, 0);
+    } else if (::dup2(fd, LISTEN_FDS_START) < 0) {
+        _exit(127);
+    }
+    char pidText[32];
+    std::snprintf(pidText, sizeof(pidText), "%lld", static_cast<long long>(::getpid()));
+    ::setenv(LISTEN_FDS_ENV, "1", 1);
+    ::setenv(LISTEN_PID_ENV, pidText, 1);
+    ::setenv(LISTEN_FDNAMES_ENV, "control", 1);
+    
+    ::execvp(argv[0], argv.data());
+    std::fprintf(stderr, "Failed to start %s: %s\n", argv[0], std::strerror(errno));
+    _exit(127);
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    // Same profile directories as the daemon
+    app.setApplicationName("DiscordDrawingRPC");
+    app.setOrganizationName("TheGameratorT");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Start the daemon on the first connection to its control socket");
+    parser.addHelpOption();
+    QCommandLineOption socketOption("socket", "Socket path to listen on, the daemon's control socket by default.", "path");
+    parser.addOption(socketOption);
+    parser.addPositionalArgument("command", "Command to start on connection, usually the daemon, and its arguments.", "command [args...]");
+    parser.process(app);
+    
+    const QStringList command = parser.positionalArguments();
+    if (command.isEmpty()) {
+        parser.showHelp(1);
+    }
+    
+    // Built up front, the child only execs
+    std::vector<QByteArray> arguments;
+    for (const QString& argument : command) {
+        arguments.push_back(QFile::encodeName(argument));
+    }
+    std::vector<char*> commandArgv;
+    for (QByteArray& argument : arguments) {
+        commandArgv.push_back(argument.data());
+    }
+    commandArgv.push_back(nullptr);
+    
+    QByteArray path = QFile::encodeName(parser.isSet(socketOption)
+        ? parser.value(socketOption)
+        : Config::instance().getControlSocketPath());
+    int fd = listenOn(path);
+    if (fd < 0) {
+        return 1;
+    }
+    std::printf("Listening on %s\n", path.constData());
+    std::fflush(stdout);
+    
+    // No SA_RESTART, so poll() and waitpid() return on a signal
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    
+    while (!g_stop) {
+        pollfd pending = { fd, POLLIN, 0 };
+        if (::poll(&pending, 1, -1) <= 0) {
+            continue;
+        }
+        
+        QElapsedTimer runTime;
+        runTime.start();
+        pid_t pid = spawn(fd, commandArgv);
+        if (pid < 0) {
+            std::fprintf(stderr, "Failed to fork: %s\n", std::strerror(errno));
+            break;
+        }
+        std::printf("Connection pending, started %s as %lld\n", arguments.front().constData(), static_cast<long long>(pid));
+        std::fflush(stdout);
+        
+        int status = 0;
+        while (::waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) {
+                break;
+            }
+            if (g_stop) {
+                ::kill(pid, SIGTERM);
+            }
+        }
+        
+        if (WIFSIGNALED(status)) {
+            std::printf("%lld killed by signal %d\n", static_cast<long long>(pid), WTERMSIG(status));
+        } else {
+            std::printf("%lld exited with %d after %lld ms\n", static_cast<long long>(pid), WEXITSTATUS(status),
+                        static_cast<long long>(runTime.elapsed()));
+        }
+        std::fflush(stdout);
+        
+        if (!g_stop && runTime.elapsed() < MIN_RUN_MS) {
+            ::sleep(RESTART_DELAY_S);
+        }
+    }
+    
+    ::close(fd);
+    ::unlink(path.constData());
+    return 0;
+}